@@ -0,0 +1,108 @@
+#include "AllocCounter.hpp"
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+
+// Replacement global allocation functions. Each block carries a header holding
+// its requested size so unsized deletes can be accounted for; the header is
+// max_align_t sized to keep the returned pointer suitably aligned; over-aligned
+// (std::align_val_t) blocks widen it to the requested alignment.
+
+namespace {
+
+constexpr std::size_t kHeader = alignof(std::max_align_t);
+
+// Plain thread_local PODs: no dynamic initialization, safe to touch from
+// operator new at any point of a thread's lifetime.
+thread_local uint64_t t_allocs = 0;
+thread_local uint64_t t_frees = 0;
+thread_local uint64_t t_bytes_allocated = 0;
+thread_local uint64_t t_bytes_freed = 0;
+thread_local int64_t  t_peak_live = 0;
+
+std::size_t header_for(std::size_t align) noexcept { return align > kHeader ? align : kHeader; }
+
+void* counted_alloc(std::size_t n, std::size_t align = kHeader) noexcept {
+    const std::size_t header = header_for(align);
+    void* p = nullptr;
+    if (header == kHeader) {
+        p = std::malloc(n + header);
+    } else {
+        // aligned_alloc wants the size to be a multiple of the alignment
+        const std::size_t total = (n + header + align - 1) / align * align;
+        p = std::aligned_alloc(align, total);
+    }
+    if (!p) return nullptr;
+    *static_cast<std::size_t*>(p) = n;
+    ++t_allocs;
+    t_bytes_allocated += n;
+    const int64_t live = int64_t(t_bytes_allocated) - int64_t(t_bytes_freed);
+    if (live > t_peak_live) t_peak_live = live;
+    return static_cast<char*>(p) + header;
+}
+
+void counted_free(void* p, std::size_t align = kHeader) noexcept {
+    if (!p) return;
+    void* base = static_cast<char*>(p) - header_for(align);
+    ++t_frees;
+    t_bytes_freed += *static_cast<std::size_t*>(base);
+    std::free(base);
+}
+
+void* throwing_alloc(std::size_t n, std::size_t align = kHeader) {
+    if (n == 0) n = 1;
+    for (;;) {
+        if (void* p = counted_alloc(n, align)) return p;
+        std::new_handler h = std::get_new_handler();
+        if (!h) throw std::bad_alloc();
+        h();
+    }
+}
+
+} // namespace
+
+namespace alloc_counter {
+
+Snapshot thread_snapshot() {
+    Snapshot s;
+    s.allocs = t_allocs;
+    s.frees = t_frees;
+    s.bytes_allocated = t_bytes_allocated;
+    s.bytes_freed = t_bytes_freed;
+    s.peak_live_bytes = t_peak_live;
+    return s;
+}
+
+void reset_peak() {
+    t_peak_live = int64_t(t_bytes_allocated) - int64_t(t_bytes_freed);
+}
+
+} // namespace alloc_counter
+
+void* operator new(std::size_t n) { return throwing_alloc(n); }
+void* operator new[](std::size_t n) { return throwing_alloc(n); }
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept { return counted_alloc(n ? n : 1); }
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept { return counted_alloc(n ? n : 1); }
+
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete(void* p, std::size_t) noexcept { counted_free(p); }
+void operator delete[](void* p, std::size_t) noexcept { counted_free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { counted_free(p); }
+
+void* operator new(std::size_t n, std::align_val_t a) { return throwing_alloc(n, std::size_t(a)); }
+void* operator new[](std::size_t n, std::align_val_t a) { return throwing_alloc(n, std::size_t(a)); }
+void* operator new(std::size_t n, std::align_val_t a, const std::nothrow_t&) noexcept {
+    return counted_alloc(n ? n : 1, std::size_t(a));
+}
+void* operator new[](std::size_t n, std::align_val_t a, const std::nothrow_t&) noexcept {
+    return counted_alloc(n ? n : 1, std::size_t(a));
+}
+
+void operator delete(void* p, std::align_val_t a) noexcept { counted_free(p, std::size_t(a)); }
+void operator delete[](void* p, std::align_val_t a) noexcept { counted_free(p, std::size_t(a)); }
+void operator delete(void* p, std::size_t, std::align_val_t a) noexcept { counted_free(p, std::size_t(a)); }
+void operator delete[](void* p, std::size_t, std::align_val_t a) noexcept { counted_free(p, std::size_t(a)); }
+void operator delete(void* p, std::align_val_t a, const std::nothrow_t&) noexcept { counted_free(p, std::size_t(a)); }
+void operator delete[](void* p, std::align_val_t a, const std::nothrow_t&) noexcept { counted_free(p, std::size_t(a)); }
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+
+// Counters maintained by the replacement global operator new/delete in
+// AllocCounter.cpp. Link that file into a benchmark binary to enable them;
+// every binary that does so pays a 16-byte header and a few thread-local
+// increments per allocation.
+//
+// Counters are per thread. Memory freed by a different thread than the one that
+// allocated it is credited to the freeing thread, so live/peak bytes are only
+// meaningful for single-threaded measurements.
+namespace alloc_counter {
+
+struct Snapshot {
+    uint64_t allocs = 0;
+    uint64_t frees = 0;
+    uint64_t bytes_allocated = 0;   // requested bytes, excluding the counter header
+    uint64_t bytes_freed = 0;
+    int64_t  peak_live_bytes = 0;   // high-water mark of live_bytes() since reset_peak()
+
+    int64_t live_bytes() const { return int64_t(bytes_allocated) - int64_t(bytes_freed); }
+};
+
+// Counters of the calling thread.
+Snapshot thread_snapshot();
+
+// Activity between two snapshots of the same thread (peak is taken from `end`).
+inline Snapshot operator-(const Snapshot& end, const Snapshot& start) {
+    Snapshot d;
+    d.allocs = end.allocs - start.allocs;
+    d.frees = end.frees - start.frees;
+    d.bytes_allocated = end.bytes_allocated - start.bytes_allocated;
+    d.bytes_freed = end.bytes_freed - start.bytes_freed;
+    d.peak_live_bytes = end.peak_live_bytes;
+    return d;
+}
+
+// Restart the calling thread's peak tracking from its current live bytes.
+void reset_peak();
+
+} // namespace alloc_counter
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+// Offline optimal hit rate (Belady's MIN) for a fixed key sequence.
+//
+// The constructor records, for every request, the position of the next request
+// to the same key (one backward pass). Simulation then keeps each resident key
+// identified by its next-use position: a request at position i hits iff i is in
+// the resident set, and on a miss the resident used farthest in the future is
+// evicted, or the new key is bypassed if it is needed later than all of them.
+// Bypass makes this the upper bound for admission-filtered caches (TinyLFU) as
+// well as for plain demand-fill ones. O(n log capacity) per capacity.
+class BeladyOracle {
+public:
+    static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+    template <typename Key>
+    explicit BeladyOracle(const std::vector<Key>& trace) : next_use_(trace.size(), npos) {
+        std::unordered_map<Key, size_t> last_seen;
+        last_seen.reserve(trace.size() / 4 + 16);
+        for (size_t i = trace.size(); i-- > 0;) {
+            auto [it, inserted] = last_seen.try_emplace(trace[i], i);
+            if (!inserted) {
+                next_use_[i] = it->second;
+                it->second = i;
+            }
+        }
+    }
+
+    size_t size() const { return next_use_.size(); }
+
+    // Hits OPT gets on trace[0, end) with `capacity` slots, counting only requests at
+    // positions >= begin (earlier ones warm the cache).
+    uint64_t hits(size_t capacity, size_t begin = 0, size_t end = npos) const {
+        if (end > next_use_.size()) end = next_use_.size();
+        if (capacity == 0) return 0;
+        std::set<size_t> resident; // next-use positions of resident keys
+        uint64_t h = 0;
+        for (size_t i = 0; i < end; ++i) {
+            size_t nu = next_use_[i];
+            if (nu >= end) nu = npos;
+            auto it = resident.find(i);
+            if (it != resident.end()) {
+                if (i >= begin) ++h;
+                resident.erase(it);
+            } else if (nu != npos && resident.size() >= capacity) {
+                auto farthest = std::prev(resident.end());
+                if (*farthest <= nu) continue; // bypass: needed later than every resident
+                resident.erase(farthest);
+            }
+            if (nu != npos) resident.insert(nu); // keys never used again are not kept
+        }
+        return h;
+    }
+
+    double hit_rate(size_t capacity, size_t begin = 0, size_t end = npos) const {
+        if (end > next_use_.size()) end = next_use_.size();
+        return end > begin ? double(hits(capacity, begin, end)) / double(end - begin) : 0.0;
+    }
+
+private:
+    std::vector<size_t> next_use_;
+};
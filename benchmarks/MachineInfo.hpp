@@ -0,0 +1,104 @@
+#pragma once
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <thread>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+// Host and build description attached to benchmark results, so runs from
+// different machines or builds can be told apart and diffed. The build fields
+// come from the compiler; flags are passed in by CMake as PCACHE_BUILD_TYPE and
+// PCACHE_CXX_FLAGS when the target defines them. The instrumentation switches
+// (PCACHE_DISABLE_STATS etc.) are compile definitions, not flags, so
+// build_options lists the ones this translation unit was built with.
+struct MachineInfo {
+    std::string host;
+    std::string cpu_model;
+    unsigned logical_cores = 0;
+    std::string os;
+    std::string compiler;
+    std::string build_type;
+    std::string cxx_flags;
+    std::string build_options;  // space-separated PCACHE_* switches, empty if none
+    std::string timestamp;      // UTC, ISO 8601
+
+    static MachineInfo collect() {
+        MachineInfo m;
+        m.logical_cores = std::thread::hardware_concurrency();
+#if defined(__unix__) || defined(__APPLE__)
+        char name[256] = {};
+        if (gethostname(name, sizeof(name) - 1) == 0) m.host = name;
+#endif
+        m.cpu_model = "unknown";
+#if defined(__linux__)
+        std::ifstream in("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.compare(0, 10, "model name") != 0) continue;
+            const auto colon = line.find(':');
+            if (colon == std::string::npos) break;
+            const auto start = line.find_first_not_of(" \t", colon + 1);
+            m.cpu_model = start == std::string::npos ? std::string() : line.substr(start);
+            break;
+        }
+        m.os = "linux";
+#elif defined(__APPLE__)
+        m.os = "macos";
+#elif defined(_WIN32)
+        m.os = "windows";
+#else
+        m.os = "unknown";
+#endif
+#if defined(__clang__)
+        m.compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+        m.compiler = "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+        m.compiler = "msvc " + std::to_string(_MSC_FULL_VER);
+#else
+        m.compiler = "unknown";
+#endif
+#if defined(PCACHE_BUILD_TYPE)
+        m.build_type = PCACHE_BUILD_TYPE;
+#endif
+#if defined(PCACHE_CXX_FLAGS)
+        m.cxx_flags = PCACHE_CXX_FLAGS;
+        m.cxx_flags.erase(0, m.cxx_flags.find_first_not_of(' '));
+        m.cxx_flags.erase(m.cxx_flags.find_last_not_of(' ') + 1);
+#endif
+        const auto option = [&m](const char* name) {
+            if (!m.build_options.empty()) m.build_options += ' ';
+            m.build_options += name;
+        };
+#if defined(PCACHE_DISABLE_STATS)
+        option("PCACHE_DISABLE_STATS");
+#endif
+#if defined(PCACHE_LOCK_STATS)
+        option("PCACHE_LOCK_STATS");
+#endif
+#if defined(PCACHE_STAGE_TIMING)
+        option("PCACHE_STAGE_TIMING");
+#endif
+#if defined(PCACHE_ENABLE_SDT)
+        option("PCACHE_ENABLE_SDT");
+#endif
+        (void)option;
+#if defined(NDEBUG)
+        if (m.build_type.empty()) m.build_type = "NDEBUG";
+#endif
+        const std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        char buf[32];
+        std::tm tm{};
+#if defined(_WIN32)
+        gmtime_s(&tm, &now);
+#else
+        gmtime_r(&now, &tm);
+#endif
+        std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm);
+        m.timestamp = buf;
+        return m;
+    }
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "LogHistogram.hpp"
+
+// Open-loop load generator. Each thread follows its own seeded arrival schedule
+// (constant spacing or Poisson) at rate/threads requests per second, independent of
+// how long requests take. Latency is measured from the *intended* send time, so a
+// stall that delays later requests is charged to every request it delayed instead
+// of only the one that hit it (coordinated-omission correction); service time from
+// the actual send is reported alongside for comparison.
+//
+// A thread that falls behind issues back to back until it catches up. Requests
+// scheduled before the deadline but never issued are counted in `unsent` and
+// recorded with their age at the deadline, a lower bound on their latency.
+struct OpenLoopOptions {
+    enum class Arrival { kConstant, kPoisson };
+    double rate = 100000.0;   // offered requests/s across all threads
+    size_t threads = 1;
+    double duration_s = 2.0;
+    Arrival arrival = Arrival::kPoisson;
+    uint64_t seed = 123;
+};
+
+struct OpenLoopResult {
+    double offered_rate = 0;
+    double achieved_rate = 0;   // completed / elapsed
+    double elapsed_s = 0;
+    uint64_t completed = 0;
+    uint64_t hits = 0;          // requests for which the op returned true
+    uint64_t unsent = 0;
+    LogHistogram latency_ns;    // intended send -> completion
+    LogHistogram service_ns;    // actual send -> completion
+};
+
+namespace open_loop_detail {
+using Clock = std::chrono::steady_clock;
+
+// sleep_until overshoots by tens of microseconds; sleep to just before the target and spin the rest
+inline void wait_until(Clock::time_point t) {
+    constexpr auto kSpin = std::chrono::microseconds(100);
+    auto now = Clock::now();
+    if (t - now > kSpin) std::this_thread::sleep_until(t - kSpin);
+    while (Clock::now() < t) std::this_thread::yield();
+}
+} // namespace open_loop_detail
+
+// op(thread) issues one request from the given thread and returns whether it hit.
+// Throws std::invalid_argument unless o.rate > 0.
+template <typename Op>
+OpenLoopResult run_open_loop(const OpenLoopOptions& o, Op&& op) {
+    using namespace open_loop_detail;
+    if (!(o.rate > 0)) throw std::invalid_argument("open loop: rate must be > 0");
+    const size_t threads = std::max<size_t>(1, o.threads);
+    const double per_thread_rate = o.rate / double(threads);
+    std::vector<OpenLoopResult> per(threads);
+
+    const auto start = Clock::now() + std::chrono::milliseconds(10);
+    const auto end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(o.duration_s));
+    std::vector<std::thread> pool;
+    for (size_t t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t] {
+            OpenLoopResult& r = per[t];
+            std::mt19937_64 rng(o.seed + 0x9e3779b97f4a7c15ULL * (t + 1));
+            std::exponential_distribution<double> gap(per_thread_rate);
+            auto next_gap = [&] {
+                const double s = o.arrival == OpenLoopOptions::Arrival::kPoisson ? gap(rng) : 1.0 / per_thread_rate;
+                return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(s));
+            };
+            // stagger constant-rate threads across one interval
+            auto intended = start + (o.arrival == OpenLoopOptions::Arrival::kPoisson
+                                         ? next_gap()
+                                         : next_gap() * long(t) / long(threads));
+            while (intended < end) {
+                auto now = Clock::now();
+                if (now >= end) break;
+                if (now < intended) {
+                    wait_until(intended);
+                    now = Clock::now();
+                }
+                if (op(t)) ++r.hits;
+                const auto done = Clock::now();
+                r.latency_ns.record(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(done - intended).count()));
+                r.service_ns.record(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(done - now).count()));
+                ++r.completed;
+                intended += next_gap();
+            }
+            for (; intended < end; intended += next_gap()) {
+                r.latency_ns.record(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(end - intended).count()));
+                ++r.unsent;
+            }
+        });
+    }
+    for (auto& th : pool) th.join();
+
+    OpenLoopResult total;
+    total.offered_rate = o.rate;
+    total.elapsed_s = std::chrono::duration<double>(Clock::now() - start).count();
+    for (const auto& r : per) {
+        total.completed += r.completed;
+        total.hits += r.hits;
+        total.unsent += r.unsent;
+        total.latency_ns.merge(r.latency_ns);
+        total.service_ns.merge(r.service_ns);
+    }
+    total.achieved_rate = double(total.completed) / std::max(1e-9, total.elapsed_s);
+    return total;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware counters for the calling thread via Linux perf_event_open.
+// Each event is opened on its own, so an event the CPU or kernel does not offer
+// (or perf_event_paranoid forbids) is simply left out; when none can be opened,
+// or on other platforms, available() is false and every call is a no-op.
+// Counts are user-space only and scaled for multiplexing.
+class PerfCounters {
+public:
+    enum Event { kCycles, kInstructions, kBranches, kBranchMisses, kL1dMisses, kLlcMisses, kNumEvents };
+
+    struct Sample {
+        std::array<bool, kNumEvents> valid{};
+        std::array<double, kNumEvents> value{};
+    };
+
+    PerfCounters() {
+        fds_.fill(-1);
+#if defined(__linux__)
+        static constexpr uint32_t kTypes[kNumEvents] = {
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+            PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE
+        };
+        static constexpr uint64_t kConfigs[kNumEvents] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_LL  | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+        };
+        for (int e = 0; e < kNumEvents; ++e) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = kTypes[e];
+            attr.config = kConfigs[e];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds_[e] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+            if (fds_[e] >= 0) available_ = true;
+        }
+#endif
+    }
+
+    ~PerfCounters() {
+#if defined(__linux__)
+        for (int fd : fds_) if (fd >= 0) close(fd);
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const { return available_; }
+
+    // Zero and start all open counters.
+    void start() {
+#if defined(__linux__)
+        for (int fd : fds_) {
+            if (fd < 0) continue;
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    void stop() {
+#if defined(__linux__)
+        for (int fd : fds_) if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+#endif
+    }
+
+    // Counts since the last start().
+    Sample read() const {
+        Sample s;
+#if defined(__linux__)
+        for (int e = 0; e < kNumEvents; ++e) {
+            if (fds_[e] < 0) continue;
+            uint64_t buf[3]; // value, time_enabled, time_running
+            if (::read(fds_[e], buf, sizeof(buf)) != static_cast<ssize_t>(sizeof(buf)) || buf[2] == 0) continue;
+            s.valid[e] = true;
+            s.value[e] = double(buf[0]) * double(buf[1]) / double(buf[2]);
+        }
+#endif
+        return s;
+    }
+
+    static const char* name(Event e) {
+        static constexpr const char* kNames[kNumEvents] = {
+            "cycles", "instructions", "branches", "branch_misses", "l1d_misses", "llc_misses"
+        };
+        return kNames[e];
+    }
+
+private:
+    std::array<int, kNumEvents> fds_{};
+    bool available_ = false;
+};
@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Local stand-in for the slow store behind a cache. Every request pays a fixed
+// overhead plus a latency drawn from a configurable distribution, and at most
+// `concurrency` requests are in service at once (the rest queue, as they would on
+// a connection pool). fetch() blocks the caller; fetch_async() runs on the
+// backend's own worker threads and reports through a callback.
+struct BackendOptions {
+    enum class Latency { kConstant, kUniform, kExponential, kLognormal };
+    Latency dist = Latency::kExponential;
+    double mean_us = 500.0;     // mean service latency
+    double spread = 0.5;        // uniform: +-spread*mean; lognormal: sigma of the log
+    double overhead_us = 20.0;  // fixed per-request cost, added to every request
+    size_t concurrency = 32;    // requests in service at once
+    size_t async_workers = 16;  // threads serving fetch_async()
+    size_t value_size = 64;     // bytes per returned value
+};
+
+class SimulatedBackend {
+public:
+    using Value = std::string;
+    using Callback = std::function<void(uint64_t key, Value value)>;
+
+    explicit SimulatedBackend(const BackendOptions& o) : o_(o) {
+        for (size_t i = 0; i < o_.async_workers; ++i) workers_.emplace_back([this] { worker(); });
+    }
+
+    // Finishes queued async requests (running their callbacks) before returning.
+    ~SimulatedBackend() {
+        {
+            std::scoped_lock l(qmu_);
+            stop_ = true;
+        }
+        qcv_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+
+    SimulatedBackend(const SimulatedBackend&) = delete;
+    SimulatedBackend& operator=(const SimulatedBackend&) = delete;
+
+    Value fetch(uint64_t key) {
+        {
+            std::unique_lock l(slot_mu_);
+            slot_cv_.wait(l, [&] { return in_service_ < o_.concurrency; });
+            ++in_service_;
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(o_.overhead_us + sample_latency_us()));
+        {
+            std::scoped_lock l(slot_mu_);
+            --in_service_;
+        }
+        slot_cv_.notify_one();
+        requests_.fetch_add(1, std::memory_order_relaxed);
+        Value v(o_.value_size, 'v');
+        if (!v.empty()) v[0] = char(key); // value depends on the key
+        return v;
+    }
+
+    void fetch_async(uint64_t key, Callback done) {
+        {
+            std::scoped_lock l(qmu_);
+            queue_.emplace_back(key, std::move(done));
+        }
+        qcv_.notify_one();
+    }
+
+    uint64_t requests() const { return requests_.load(std::memory_order_relaxed); }
+
+private:
+    double sample_latency_us() {
+        thread_local std::mt19937_64 rng(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        const double m = o_.mean_us;
+        switch (o_.dist) {
+        case BackendOptions::Latency::kConstant:
+            return m;
+        case BackendOptions::Latency::kUniform:
+            return std::uniform_real_distribution<double>(m * (1.0 - o_.spread), m * (1.0 + o_.spread))(rng);
+        case BackendOptions::Latency::kExponential:
+            return std::exponential_distribution<double>(1.0 / m)(rng);
+        case BackendOptions::Latency::kLognormal: {
+            // pick mu so the mean stays at m
+            const double s = o_.spread;
+            return std::lognormal_distribution<double>(std::log(m) - 0.5 * s * s, s)(rng);
+        }
+        }
+        return m;
+    }
+
+    void worker() {
+        for (;;) {
+            std::pair<uint64_t, Callback> job;
+            {
+                std::unique_lock l(qmu_);
+                qcv_.wait(l, [&] { return stop_ || !queue_.empty(); });
+                if (queue_.empty()) return; // stopping and drained
+                job = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            job.second(job.first, fetch(job.first));
+        }
+    }
+
+    BackendOptions o_;
+
+    std::mutex slot_mu_;
+    std::condition_variable slot_cv_;
+    size_t in_service_ = 0;
+
+    std::mutex qmu_;
+    std::condition_variable qcv_;
+    std::deque<std::pair<uint64_t, Callback>> queue_;
+    bool stop_ = false;
+    std::vector<std::thread> workers_;
+
+    std::atomic<uint64_t> requests_{0};
+};
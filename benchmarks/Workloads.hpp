@@ -0,0 +1,303 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "KeyHash.hpp"
+#include "ZipfGenerator.hpp"
+
+// Parametrized synthetic key streams shared by the benchmarks and the simulator.
+// A workload is named by a spec string "name" or "name:param=value,param=value";
+// omitted parameters take the defaults listed in workload_help(). Keys are dense
+// non-negative integers (a workload with n keys plus its extra ranges stays below
+// a few times n), so streams fit int-keyed benchmarks as well as uint64 ones.
+// Every generator is deterministic for a given spec and seed.
+//
+//   auto next = make_workload(WorkloadSpec::parse("scan_zipf:n=10000,every=50000"), 123);
+//   auto keys = pregenerate_keys<uint64_t>(1 << 20, next);
+struct WorkloadSpec {
+    std::string name;
+    std::map<std::string, double> params;
+
+    static WorkloadSpec parse(const std::string& s) {
+        WorkloadSpec w;
+        const auto colon = s.find(':');
+        w.name = s.substr(0, colon);
+        if (colon == std::string::npos) return w;
+        std::stringstream ss(s.substr(colon + 1));
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            if (item.empty()) continue;
+            const auto eq = item.find('=');
+            if (eq == std::string::npos) throw std::invalid_argument("workload parameter needs name=value: " + item);
+            w.params[item.substr(0, eq)] = std::stod(item.substr(eq + 1));
+        }
+        return w;
+    }
+
+    std::string str() const {
+        std::ostringstream os;
+        os << name;
+        char sep = ':';
+        for (const auto& [k, v] : params) { os << sep << k << '=' << v; sep = ','; }
+        return os.str();
+    }
+};
+
+using KeyGenerator = std::function<uint64_t()>;
+
+namespace workload_detail {
+
+// Parameter lookup that remembers which names were read, so typos are reported.
+class Params {
+public:
+    explicit Params(const WorkloadSpec& w) : w_(w) {}
+    double get(const std::string& k, double def) {
+        used_.insert(k);
+        auto it = w_.params.find(k);
+        return it == w_.params.end() ? def : it->second;
+    }
+    uint64_t count(const std::string& k, double def) {
+        const double v = get(k, def);
+        if (!(v >= 1.0)) throw std::invalid_argument(w_.name + ": " + k + " must be >= 1");
+        return uint64_t(v);
+    }
+    double prob(const std::string& k, double def) {
+        const double v = get(k, def);
+        if (v < 0.0 || v > 1.0) throw std::invalid_argument(w_.name + ": " + k + " must be in [0, 1]");
+        return v;
+    }
+    void check_unused() const {
+        for (const auto& [k, v] : w_.params)
+            if (!used_.count(k)) throw std::invalid_argument(w_.name + ": unknown parameter " + k);
+    }
+
+private:
+    const WorkloadSpec& w_;
+    std::set<std::string> used_;
+};
+
+struct Uniform {
+    std::mt19937_64 rng;
+    std::uniform_int_distribution<uint64_t> dist;
+    uint64_t operator()() { return dist(rng); }
+};
+
+struct Zipf {
+    std::mt19937_64 rng;
+    ZipfGenerator zipf;
+    uint64_t operator()() { return zipf(rng); }
+};
+
+// Zipf whose hot set slides through the key space: every `period` requests the
+// rank-to-key mapping shifts by `shift`, so yesterday's hot keys cool gradually.
+struct DriftingZipf {
+    std::mt19937_64 rng;
+    ZipfGenerator zipf;
+    uint64_t period, shift, i = 0, offset = 0;
+    uint64_t operator()() {
+        if (++i % period == 0) offset = (offset + shift) % zipf.n();
+        return (zipf(rng) + offset) % zipf.n();
+    }
+};
+
+// Zipf traffic interrupted every `every` requests by one full sequential scan of a
+// separate `scan`-key range (keys [n, n + scan)), e.g. a periodic batch job.
+struct ScanZipf {
+    std::mt19937_64 rng;
+    ZipfGenerator zipf;
+    uint64_t every, scan, i = 0, pos = 0;
+    bool scanning = false;
+    uint64_t operator()() {
+        if (scanning) {
+            const uint64_t k = zipf.n() + pos;
+            if (++pos == scan) { scanning = false; pos = 0; }
+            return k;
+        }
+        if (++i % every == 0) scanning = true;
+        return zipf(rng);
+    }
+};
+
+// Cyclic access to `len` keys; with len > capacity, LRU gets no hits at all.
+struct Loop {
+    uint64_t len, i = 0;
+    uint64_t operator()() {
+        const uint64_t k = i;
+        if (++i == len) i = 0;
+        return k;
+    }
+};
+
+// Two populations (keys [0, n) "day", [n, 2n) "night") with Zipf popularity each;
+// the share of day traffic follows (1 + cos(2*pi*t/period)) / 2.
+struct Diurnal {
+    std::mt19937_64 rng;
+    ZipfGenerator zipf;
+    uint64_t period, i = 0;
+    std::uniform_real_distribution<double> uni{0.0, 1.0};
+    uint64_t operator()() {
+        const double day = 0.5 * (1.0 + std::cos(6.283185307179586 * double(i++ % period) / double(period)));
+        const uint64_t r = zipf(rng);
+        return uni(rng) < day ? r : zipf.n() + r;
+    }
+};
+
+// Zipf background; every `every` requests a burst of `len` requests starts in which a
+// fraction `frac` go uniformly to `keys` never-seen keys (ids above n, never reused).
+struct Bursty {
+    std::mt19937_64 rng;
+    ZipfGenerator zipf;
+    uint64_t every, len, keys;
+    double frac;
+    uint64_t i = 0, next_fresh = 0, burst_base = 0, burst_left = 0;
+    std::uniform_real_distribution<double> uni{0.0, 1.0};
+    uint64_t operator()() {
+        if (++i % every == 0) {
+            burst_base = zipf.n() + next_fresh;
+            next_fresh += keys;
+            burst_left = len;
+        }
+        if (burst_left > 0) {
+            --burst_left;
+            if (uni(rng) < frac) return burst_base + std::uniform_int_distribution<uint64_t>(0, keys - 1)(rng);
+        }
+        return zipf(rng);
+    }
+};
+
+// `tenants` independent Zipf key spaces of n keys each (tenant t owns [t*n, (t+1)*n)),
+// tenant t with skew s + t*ds and traffic share proportional to (t+1)^-weight_skew.
+struct Tenants {
+    std::mt19937_64 rng;
+    std::vector<ZipfGenerator> zipfs;
+    std::discrete_distribution<size_t> pick;
+    uint64_t operator()() {
+        const size_t t = pick(rng);
+        return uint64_t(t) * zipfs[t].n() + zipfs[t](rng);
+    }
+};
+
+// Interleaved user sessions walking a random graph over n keys. Each key has `fanout`
+// fixed successors (derived by hashing, no table); a session follows one with
+// probability p (successor j chosen Zipf(1) so the first dominates), otherwise jumps
+// to a Zipf-popular key. Sessions last `session` requests on average (geometric),
+// restarting at a Zipf-popular key, or never end with session=0; `users` of them are
+// interleaved at random, as on a shared server. p = 1 with one user and fanout 1 is
+// predictable except at session restarts, and fully with session=0; p = 0 is plain Zipf.
+struct MarkovSessions {
+    std::mt19937_64 rng;
+    ZipfGenerator popular;
+    ZipfGenerator successor;
+    double p;
+    double end_prob;
+    uint64_t salt;
+    std::vector<uint64_t> current;
+    std::uniform_real_distribution<double> uni{0.0, 1.0};
+    uint64_t operator()() {
+        const size_t u = std::uniform_int_distribution<size_t>(0, current.size() - 1)(rng);
+        uint64_t& cur = current[u];
+        if (uni(rng) < end_prob) cur = popular(rng);                 // new session
+        else if (uni(rng) < p) cur = mix64(cur * successor.n() + successor(rng) + salt) % popular.n();
+        else cur = popular(rng);
+        return cur;
+    }
+};
+
+} // namespace workload_detail
+
+// Names and parameters (with defaults) of every workload make_workload() accepts.
+inline const char* workload_help() {
+    return "  uniform:n=100000\n"
+           "  zipf:n=100000,s=0.99\n"
+           "  drift_zipf:n=100000,s=0.99,period=10000,shift=100\n"
+           "  scan_zipf:n=100000,s=0.99,every=100000,scan=20000\n"
+           "  loop:len=20000\n"
+           "  diurnal:n=100000,s=0.99,period=1000000\n"
+           "  bursty:n=100000,s=0.99,every=100000,len=20000,keys=1000,frac=0.5\n"
+           "  tenants:tenants=4,n=25000,s=0.8,ds=0.2,weight_skew=1\n"
+           "  markov:n=100000,fanout=4,p=0.8,session=50,users=1,s=0.99\n";
+}
+
+// One spec per stress pattern, scaled to a cache of `capacity` entries (key spaces of
+// about 10x capacity). Shared by the benchmarks so their scenarios line up.
+inline std::vector<std::string> standard_workloads(size_t capacity) {
+    const std::string n = std::to_string(10 * capacity);
+    const auto c = [&](double f) { return std::to_string(uint64_t(f * double(capacity))); };
+    return {
+        "zipf:n=" + n + ",s=0.99",
+        "drift_zipf:n=" + n + ",s=0.99,period=" + c(1) + ",shift=" + c(0.01),
+        "scan_zipf:n=" + n + ",s=0.99,every=" + c(20) + ",scan=" + c(5),
+        "loop:len=" + c(3),
+        "diurnal:n=" + n + ",s=0.99,period=" + c(200),
+        "bursty:n=" + n + ",s=0.99,every=" + c(20) + ",len=" + c(5) + ",keys=" + c(0.2) + ",frac=0.5",
+        "tenants:tenants=4,n=" + c(2.5) + ",s=0.8,ds=0.2",
+        "markov:n=" + n + ",fanout=2,p=0.9,session=100",
+    };
+}
+
+// Builds the generator for `w`; throws std::invalid_argument for an unknown name or
+// parameter, or an out-of-range value.
+inline KeyGenerator make_workload(const WorkloadSpec& w, uint64_t seed) {
+    using namespace workload_detail;
+    Params p(w);
+    std::mt19937_64 rng(seed);
+    KeyGenerator gen;
+    if (w.name == "uniform") {
+        gen = Uniform{rng, std::uniform_int_distribution<uint64_t>(0, p.count("n", 100000) - 1)};
+    } else if (w.name == "zipf") {
+        gen = Zipf{rng, ZipfGenerator(p.count("n", 100000), p.get("s", 0.99))};
+    } else if (w.name == "drift_zipf") {
+        ZipfGenerator z(p.count("n", 100000), p.get("s", 0.99));
+        gen = DriftingZipf{rng, z, p.count("period", 10000), p.count("shift", 100)};
+    } else if (w.name == "scan_zipf") {
+        ZipfGenerator z(p.count("n", 100000), p.get("s", 0.99));
+        gen = ScanZipf{rng, z, p.count("every", 100000), p.count("scan", 20000)};
+    } else if (w.name == "loop") {
+        gen = Loop{p.count("len", 20000)};
+    } else if (w.name == "diurnal") {
+        ZipfGenerator z(p.count("n", 100000), p.get("s", 0.99));
+        gen = Diurnal{rng, z, p.count("period", 1000000)};
+    } else if (w.name == "bursty") {
+        ZipfGenerator z(p.count("n", 100000), p.get("s", 0.99));
+        gen = Bursty{rng, z, p.count("every", 100000), p.count("len", 20000), p.count("keys", 1000),
+                     p.prob("frac", 0.5)};
+    } else if (w.name == "tenants") {
+        const uint64_t t = p.count("tenants", 4), n = p.count("n", 25000);
+        const double s = p.get("s", 0.8), ds = p.get("ds", 0.2), skew = p.get("weight_skew", 1.0);
+        std::vector<ZipfGenerator> zipfs;
+        std::vector<double> weights;
+        for (uint64_t i = 0; i < t; ++i) {
+            zipfs.emplace_back(n, std::max(0.01, s + double(i) * ds));
+            weights.push_back(std::pow(double(i + 1), -skew));
+        }
+        gen = Tenants{rng, std::move(zipfs), std::discrete_distribution<size_t>(weights.begin(), weights.end())};
+    } else if (w.name == "markov") {
+        const uint64_t n = p.count("n", 100000);
+        ZipfGenerator popular(n, p.get("s", 0.99));
+        ZipfGenerator successor(p.count("fanout", 4), 1.0);
+        const double follow = p.prob("p", 0.8);
+        const double session = p.get("session", 50);
+        if (!(session == 0.0 || session >= 1.0))
+            throw std::invalid_argument(w.name + ": session must be 0 (sessions never end) or >= 1");
+        const double end_prob = session == 0.0 ? 0.0 : 1.0 / session;
+        std::vector<uint64_t> current(p.count("users", 1));
+        for (auto& c : current) c = popular(rng);
+        gen = MarkovSessions{rng, popular, successor, follow, end_prob, mix64(seed), std::move(current)};
+    } else {
+        throw std::invalid_argument("unknown workload " + w.name);
+    }
+    p.check_unused();
+    return gen;
+}
+
+inline KeyGenerator make_workload(const std::string& spec, uint64_t seed) {
+    return make_workload(WorkloadSpec::parse(spec), seed);
+}
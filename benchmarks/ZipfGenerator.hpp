@@ -0,0 +1,75 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+// Zipf(s) over ranks [0, n) in O(1) time and memory per sample, using the
+// rejection-inversion method of Hörmann & Derflinger ("Rejection-inversion to
+// generate variates from monotone discrete distributions", 1996). Unlike
+// std::discrete_distribution there is no O(n) table, so n can be 1e9.
+// Rank 0 is the most popular key. Requires s > 0.
+class ZipfGenerator {
+public:
+    ZipfGenerator(uint64_t n, double s) : n_(n), s_(s) {
+        if (n == 0) throw std::invalid_argument("n must be > 0");
+        if (s <= 0.0) throw std::invalid_argument("s must be > 0");
+        h_integral_x1_ = h_integral(1.5) - 1.0;
+        h_integral_n_ = h_integral(double(n) + 0.5);
+        squeeze_ = 2.0 - h_integral_inverse(h_integral(2.5) - h(2.0));
+    }
+
+    template <typename URNG>
+    uint64_t operator()(URNG& rng) {
+        for (;;) {
+            const double u = h_integral_n_ + uni_(rng) * (h_integral_x1_ - h_integral_n_);
+            const double x = h_integral_inverse(u);
+            double k = std::floor(x + 0.5);
+            if (k < 1.0) k = 1.0;
+            else if (k > double(n_)) k = double(n_);
+            // accept immediately inside the squeeze, otherwise test against the hat
+            if (k - x <= squeeze_ || u >= h_integral(k + 0.5) - h(k)) {
+                return static_cast<uint64_t>(k) - 1;
+            }
+        }
+    }
+
+    uint64_t n() const { return n_; }
+    double s() const { return s_; }
+
+private:
+    // H(x) = integral of h(x) = x^-s, written to stay accurate as s -> 1
+    double h_integral(double x) const {
+        const double lx = std::log(x);
+        return helper2((1.0 - s_) * lx) * lx;
+    }
+    double h(double x) const { return std::exp(-s_ * std::log(x)); }
+    double h_integral_inverse(double x) const {
+        double t = x * (1.0 - s_);
+        if (t < -1.0) t = -1.0; // rounding guard
+        return std::exp(helper1(t) * x);
+    }
+    // log1p(x)/x and expm1(x)/x, with series expansions near 0
+    static double helper1(double x) {
+        return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+    static double helper2(double x) {
+        return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+    }
+
+    uint64_t n_;
+    double s_;
+    double h_integral_x1_, h_integral_n_, squeeze_;
+    std::uniform_real_distribution<double> uni_{0.0, 1.0};
+};
+
+// Draws `n` keys from `next` up front so generator cost stays out of timed loops.
+template <typename Key, typename NextKeyFn>
+std::vector<Key> pregenerate_keys(size_t n, NextKeyFn&& next) {
+    std::vector<Key> keys;
+    keys.reserve(n);
+    for (size_t i = 0; i < n; ++i) keys.push_back(static_cast<Key>(next()));
+    return keys;
+}
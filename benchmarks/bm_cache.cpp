@@ -2,51 +2,92 @@
 #include <random>
 #include <vector>
 #include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <string>
 #include "ShardedLRU.hpp"
 #include "ShardedWTinyLFU.hpp"
 #include "PredictiveShardedCache.hpp"
+#include "TieredCache.hpp"
+#include "Workloads.hpp"
+#include "AllocCounter.hpp"
+#include "PerfCounters.hpp"
 
 using Key = int;
 
-static std::discrete_distribution<Key> make_zipf(size_t key_space, double s) {
-    std::vector<double> w(key_space);
-    for (size_t i=0;i<key_space;++i) w[i] = 1.0/std::pow(double(i+1), s);
-    return std::discrete_distribution<Key>(w.begin(), w.end());
+// Keys drawn per pregenerated stream; the timed loop cycles through it.
+static constexpr size_t kPregenKeys = size_t(1) << 20;
+
+// allocs_per_op / bytes_per_op over the timed loop; start is taken right before it.
+static void report_allocs(benchmark::State& st, const alloc_counter::Snapshot& start) {
+    const auto d = alloc_counter::thread_snapshot() - start;
+    st.counters["allocs_per_op"] = benchmark::Counter(double(d.allocs), benchmark::Counter::kAvgIterations);
+    st.counters["bytes_per_op"] = benchmark::Counter(double(d.bytes_allocated), benchmark::Counter::kAvgIterations);
 }
 
-static void BM_LRU_Zipf(benchmark::State& st) {
-    size_t capacity = st.range(0), key_space = st.range(1), shards = 8;
-    ShardedLRU<Key, std::string> cache(capacity, shards);
-    std::mt19937 rng(123);
-    auto zipf = make_zipf(key_space, 1.2);
+// Hardware counters per op over the timed loop (started right before it); counters the
+// kernel refuses are simply not reported.
+static void report_perf(benchmark::State& st, PerfCounters& perf) {
+    perf.stop();
+    const auto s = perf.read();
+    for (int e = 0; e < PerfCounters::kNumEvents; ++e) {
+        if (!s.valid[e]) continue;
+        st.counters[std::string(PerfCounters::name(PerfCounters::Event(e))) + "_per_op"] =
+            benchmark::Counter(s.value[e], benchmark::Counter::kAvgIterations);
+    }
+    if (s.valid[PerfCounters::kCycles] && s.valid[PerfCounters::kInstructions] && s.value[PerfCounters::kCycles] > 0)
+        st.counters["ipc"] = s.value[PerfCounters::kInstructions] / s.value[PerfCounters::kCycles];
+}
+
+// Args: {capacity, key_space, pregen}. pregen=0 samples Zipf inside the timed loop,
+// pregen=1 replays a pregenerated stream so only cache cost is measured.
+template <typename Cache>
+static void run_zipf(benchmark::State& st, Cache& cache) {
+    const size_t key_space = st.range(1);
+    const bool pregen = st.range(2) != 0;
+    std::mt19937_64 rng(123);
+    ZipfGenerator zipf(key_space, 1.2);
+
+    std::vector<Key> keys;
+    if (pregen) keys = pregenerate_keys<Key>(kPregenKeys, [&]{ return zipf(rng); });
+    size_t pos = 0;
 
     size_t hits=0, misses=0;
+    PerfCounters perf;
+    const auto allocs0 = alloc_counter::thread_snapshot();
+    perf.start();
     for (auto _ : st) {
-        Key k = zipf(rng);
+        Key k = pregen ? keys[pos++ & (kPregenKeys - 1)] : Key(zipf(rng));
         if (cache.get(k)) ++hits;
         else { ++misses; cache.put(k, "x"); }
     }
+    report_perf(st, perf);
+    report_allocs(st, allocs0);
     st.counters["hit_rate"] = double(hits)/(hits+misses);
     st.counters["ops"] = hits+misses;
 }
-BENCHMARK(BM_LRU_Zipf)->Args({1000, 10000})->Unit(benchmark::kNanosecond);
+
+static void zipf_args(benchmark::internal::Benchmark* b) {
+    for (int pregen : {0, 1}) {
+        b->Args({1000, 10000, pregen});
+        b->Args({100000, 100000000, pregen});
+        b->Args({1000000, 1000000000, pregen});
+    }
+}
+
+static void BM_LRU_Zipf(benchmark::State& st) {
+    size_t capacity = st.range(0), shards = 8;
+    ShardedLRU<Key, std::string> cache(capacity, shards);
+    run_zipf(st, cache);
+}
+BENCHMARK(BM_LRU_Zipf)->Apply(zipf_args)->Unit(benchmark::kNanosecond);
 
 static void BM_TinyLFU_Zipf(benchmark::State& st) {
-    size_t capacity = st.range(0), key_space = st.range(1), shards = 8;
+    size_t capacity = st.range(0), shards = 8;
     ShardedWTinyLFU<Key, std::string> cache(capacity, shards);
-    std::mt19937 rng(123);
-    auto zipf = make_zipf(key_space, 1.2);
-
-    size_t hits=0, misses=0;
-    for (auto _ : st) {
-        Key k = zipf(rng);
-        if (cache.get(k)) ++hits;
-        else { ++misses; cache.put(k, "x"); }
-    }
-    st.counters["hit_rate"] = double(hits)/(hits+misses);
-    st.counters["ops"] = hits+misses;
+    run_zipf(st, cache);
 }
-BENCHMARK(BM_TinyLFU_Zipf)->Args({1000, 10000})->Unit(benchmark::kNanosecond);
+BENCHMARK(BM_TinyLFU_Zipf)->Apply(zipf_args)->Unit(benchmark::kNanosecond);
 
 // Predictive on sequential burst
 static void BM_Predictive_Seq(benchmark::State& st) {
@@ -64,13 +105,138 @@ static void BM_Predictive_Seq(benchmark::State& st) {
     for (int i=0;i<10000;++i) { Key k=next(); if(!cache.get(k)) cache.put(k,"x"); }
 
     size_t hits=0, misses=0;
+    PerfCounters perf;
+    const auto allocs0 = alloc_counter::thread_snapshot();
+    perf.start();
     for (auto _ : st) {
         Key k = next();
         if (cache.get(k)) ++hits; else { ++misses; cache.put(k, "x"); }
     }
+    report_perf(st, perf);
+    report_allocs(st, allocs0);
     st.counters["hit_rate"] = double(hits)/(hits+misses);
     st.counters["ops"] = hits+misses;
 }
 BENCHMARK(BM_Predictive_Seq)->Args({1000, 10000})->Unit(benchmark::kNanosecond);
 
+// Args: {capacity, index into standard_workloads(capacity)}; the spec is the label.
+template <typename Cache>
+static void run_workload(benchmark::State& st, Cache& cache) {
+    const size_t capacity = st.range(0);
+    const std::string spec = standard_workloads(capacity).at(size_t(st.range(1)));
+    const auto keys = pregenerate_keys<Key>(kPregenKeys, make_workload(spec, 123));
+    size_t pos = 0;
+    for (size_t i = 0; i < 2 * capacity; ++i) { Key k = keys[pos++]; if (!cache.get(k)) cache.put(k, "x"); }
+
+    size_t hits=0, misses=0;
+    PerfCounters perf;
+    const auto allocs0 = alloc_counter::thread_snapshot();
+    perf.start();
+    for (auto _ : st) {
+        Key k = keys[pos++ & (kPregenKeys - 1)];
+        if (cache.get(k)) ++hits;
+        else { ++misses; cache.put(k, "x"); }
+    }
+    report_perf(st, perf);
+    report_allocs(st, allocs0);
+    st.SetLabel(spec);
+    st.counters["hit_rate"] = double(hits)/(hits+misses);
+    st.counters["ops"] = hits+misses;
+}
+
+static void workload_args(benchmark::internal::Benchmark* b) {
+    const int n = int(standard_workloads(1000).size());
+    for (int w = 0; w < n; ++w) b->Args({1000, w});
+}
+
+static void BM_LRU_Workload(benchmark::State& st) {
+    ShardedLRU<Key, std::string> cache(st.range(0), 8);
+    run_workload(st, cache);
+}
+BENCHMARK(BM_LRU_Workload)->Apply(workload_args)->Unit(benchmark::kNanosecond);
+
+static void BM_TinyLFU_Workload(benchmark::State& st) {
+    ShardedWTinyLFU<Key, std::string> cache(st.range(0), 8);
+    run_workload(st, cache);
+}
+BENCHMARK(BM_TinyLFU_Workload)->Apply(workload_args)->Unit(benchmark::kNanosecond);
+
+static void BM_Predictive_Workload(benchmark::State& st) {
+    PredictiveShardedCache<Key, std::string>::Options opt;
+    opt.shards = 8;
+    PredictiveShardedCache<Key, std::string> cache(st.range(0), opt);
+    run_workload(st, cache);
+}
+BENCHMARK(BM_Predictive_Workload)->Apply(workload_args)->Unit(benchmark::kNanosecond);
+
+// ShardedWTinyLFU save()/load() of a full cache with uint64 keys and 8-byte
+// values, 16 shards. Arg: entries. The snapshot lives in the temp directory.
+static std::string snapshot_path() {
+    return (std::filesystem::temp_directory_path() / "pcache_bm_snapshot.bin").string();
+}
+
+static void fill_for_snapshot(ShardedWTinyLFU<uint64_t, uint64_t>& c, size_t n) {
+    for (uint64_t k = 0; k < n; ++k) c.put(k, k);
+}
+
+static void BM_Snapshot_Save(benchmark::State& st) {
+    const size_t n = size_t(st.range(0));
+    ShardedWTinyLFU<uint64_t, uint64_t> c(n, 16, 1 << 16);
+    fill_for_snapshot(c, n);
+    for (auto _ : st) c.save(snapshot_path());
+    st.SetItemsProcessed(int64_t(st.iterations()) * int64_t(n));
+    std::remove(snapshot_path().c_str());
+}
+BENCHMARK(BM_Snapshot_Save)->Arg(1 << 16)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+
+static void BM_Snapshot_Load(benchmark::State& st) {
+    const size_t n = size_t(st.range(0));
+    {
+        ShardedWTinyLFU<uint64_t, uint64_t> src(n, 16, 1 << 16);
+        fill_for_snapshot(src, n);
+        src.save(snapshot_path());
+    }
+    ShardedWTinyLFU<uint64_t, uint64_t> c(n, 16, 1 << 16);
+    for (auto _ : st) c.load(snapshot_path());
+    st.SetItemsProcessed(int64_t(st.iterations()) * int64_t(n));
+    std::remove(snapshot_path().c_str());
+}
+BENCHMARK(BM_Snapshot_Load)->Arg(1 << 16)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+
+// TieredCache over a DiskTier with a key space 10x the DRAM capacity, Zipf(0.9)
+// gets of 64-byte values. Arg 0: batch size, 1 = get(), > 1 = multi_get().
+// Reports the DRAM and disk hit rates; the tier file lives in the temp directory.
+static void BM_Tiered_ZipfGet(benchmark::State& st) {
+    using Core = ShardedWTinyLFU<uint64_t, std::string>;
+    const size_t capacity = 1 << 16, key_space = capacity * 10, batch = size_t(st.range(0));
+    DiskTierOptions opt;
+    opt.shards = 8;
+    TieredCache<uint64_t, std::string, Core> cache(
+        std::make_unique<Core>(capacity, 8),
+        std::make_unique<DiskTier<uint64_t, std::string>>(
+            (std::filesystem::temp_directory_path() / "pcache_bm_tier.bin").string(), uint64_t(256) << 20, opt));
+    for (uint64_t k = 0; k < key_space; ++k) cache.put(k, std::string(64, char('a' + k % 26)));
+    std::mt19937_64 rng(7);
+    ZipfGenerator zipf(key_space, 0.9);
+    std::vector<uint64_t> keys(kPregenKeys);
+    for (auto& k : keys) k = zipf(rng);
+    std::vector<uint64_t> req(batch);
+    size_t pos = 0;
+    uint64_t found = 0;
+    const uint64_t tier_hits0 = cache.tier().stats().hits;
+    for (auto _ : st) {
+        for (auto& k : req) k = keys[pos++ & (kPregenKeys - 1)];
+        if (batch == 1) {
+            found += cache.get(req[0]).has_value();
+        } else {
+            for (const auto& v : cache.multi_get(req)) found += v.has_value();
+        }
+    }
+    const double gets = double(st.iterations()) * double(batch);
+    st.SetItemsProcessed(int64_t(gets));
+    st.counters["hit_rate"] = double(found) / gets;
+    st.counters["disk_hit_rate"] = double(cache.tier().stats().hits - tier_hits0) / gets;
+}
+BENCHMARK(BM_Tiered_ZipfGet)->Arg(1)->Arg(32)->Unit(benchmark::kMicrosecond);
+
 BENCHMARK_MAIN();
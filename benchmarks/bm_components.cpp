@@ -0,0 +1,250 @@
+// Component microbenchmarks: the building blocks of the caches in isolation, so a
+// regression in the whole-cache suite (bm_cache.cpp) can be traced to a part.
+// Every benchmark sweeps its working set from L1- to DRAM-sized; the
+// `working_set_bytes` counter and the L1/L2/LLC/DRAM label show where each
+// point lands on this machine (sizes from sysconf where available).
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+#include "CountMinSketch.hpp"
+#include "MarkovPredictor.hpp"
+#include "LRUCache.hpp"
+#include "Lz4.hpp"
+
+namespace {
+
+// xorshift64*: a couple of cycles per key and no table, so the key source itself
+// adds nothing to the working set being measured
+struct FastRng {
+    uint64_t s = 0x9e3779b97f4a7c15ULL;
+    uint64_t operator()() {
+        s ^= s >> 12; s ^= s << 25; s ^= s >> 27;
+        return s * 0x2545f4914f6cdd1dULL;
+    }
+    uint64_t below(uint64_t n) { return (*this)() % n; }
+};
+
+size_t cache_size(int level, size_t fallback) {
+#if defined(__linux__) && defined(_SC_LEVEL1_DCACHE_SIZE)
+    const long v = level == 1 ? sysconf(_SC_LEVEL1_DCACHE_SIZE)
+                 : level == 2 ? sysconf(_SC_LEVEL2_CACHE_SIZE)
+                              : sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (v > 0) return size_t(v);
+#endif
+    (void)level;
+    return fallback;
+}
+
+void set_working_set(benchmark::State& st, size_t bytes) {
+    static const size_t l1 = cache_size(1, 32 << 10), l2 = cache_size(2, 1 << 20), l3 = cache_size(3, 32 << 20);
+    st.counters["working_set_bytes"] = double(bytes);
+    st.SetLabel(bytes <= l1 ? "L1" : bytes <= l2 ? "L2" : bytes <= l3 ? "LLC" : "DRAM");
+}
+
+// ---- CountMinSketch: Args {width, depth}; footprint width*depth*4 bytes ----
+
+void cms_args(benchmark::internal::Benchmark* b) {
+    for (int64_t depth : {2, 4, 8})
+        for (int64_t width : {1 << 10, 1 << 14, 1 << 18, 1 << 22}) b->Args({width, depth});
+}
+
+void BM_CMS_Add(benchmark::State& st) {
+    CountMinSketch cms(size_t(st.range(0)), size_t(st.range(1)));
+    FastRng rng;
+    for (auto _ : st) cms.add(rng());
+    set_working_set(st, size_t(st.range(0) * st.range(1)) * sizeof(uint32_t));
+}
+BENCHMARK(BM_CMS_Add)->Apply(cms_args);
+
+void BM_CMS_Estimate(benchmark::State& st) {
+    CountMinSketch cms(size_t(st.range(0)), size_t(st.range(1)));
+    FastRng rng;
+    for (int64_t i = 0; i < st.range(0); ++i) cms.add(rng());
+    for (auto _ : st) benchmark::DoNotOptimize(cms.estimate(rng()));
+    set_working_set(st, size_t(st.range(0) * st.range(1)) * sizeof(uint32_t));
+}
+BENCHMARK(BM_CMS_Estimate)->Apply(cms_args);
+
+void BM_CMS_DecayHalf(benchmark::State& st) {
+    CountMinSketch cms(size_t(st.range(0)), size_t(st.range(1)));
+    FastRng rng;
+    for (int64_t i = 0; i < st.range(0); ++i) cms.add(rng());
+    const size_t bytes = size_t(st.range(0) * st.range(1)) * sizeof(uint32_t);
+    for (auto _ : st) cms.decay_half();
+    st.SetBytesProcessed(int64_t(st.iterations()) * int64_t(bytes));
+    set_working_set(st, bytes);
+}
+BENCHMARK(BM_CMS_DecayHalf)->Apply(cms_args)->Unit(benchmark::kMicrosecond);
+
+// ---- MarkovPredictor: Args {states, fanout}; every state has `fanout` successors
+// with distinct counts, as after a training period ----
+
+constexpr size_t kMarkovEdgeBytes = 48; // approx. node + bucket per successor entry
+
+void markov_args(benchmark::internal::Benchmark* b) {
+    for (int64_t fanout : {1, 4, 16, 64})
+        for (int64_t states : {1 << 6, 1 << 10, 1 << 14, 1 << 18})
+            if (states * fanout <= (int64_t(1) << 22)) b->Args({states, fanout});
+}
+
+MarkovPredictor<uint64_t> trained_predictor(uint64_t states, uint64_t fanout) {
+    MarkovPredictor<uint64_t> p;
+    for (uint64_t s = 0; s < states; ++s)
+        for (uint64_t j = 0; j < fanout; ++j)
+            for (uint64_t c = 0; c <= fanout - j; ++c) p.observe(s, (s + 1 + j) % states);
+    return p;
+}
+
+void BM_Markov_Observe(benchmark::State& st) {
+    const uint64_t states = uint64_t(st.range(0)), fanout = uint64_t(st.range(1));
+    auto p = trained_predictor(states, fanout);
+    FastRng rng;
+    for (auto _ : st) {
+        const uint64_t s = rng.below(states);
+        p.observe(s, (s + 1 + rng.below(fanout)) % states); // existing edge: steady-state path
+    }
+    set_working_set(st, size_t(states * fanout) * kMarkovEdgeBytes);
+}
+BENCHMARK(BM_Markov_Observe)->Apply(markov_args);
+
+void BM_Markov_TopK(benchmark::State& st) {
+    const uint64_t states = uint64_t(st.range(0)), fanout = uint64_t(st.range(1));
+    const auto p = trained_predictor(states, fanout);
+    FastRng rng;
+    for (auto _ : st) benchmark::DoNotOptimize(p.topk_next(rng.below(states), 2, 1, 0.0));
+    set_working_set(st, size_t(states * fanout) * kMarkovEdgeBytes);
+}
+BENCHMARK(BM_Markov_TopK)->Apply(markov_args);
+
+// decay_half erases edges that reach zero, so each iteration decays a fresh copy
+void BM_Markov_DecayHalf(benchmark::State& st) {
+    const uint64_t states = uint64_t(st.range(0)), fanout = uint64_t(st.range(1));
+    const auto trained = trained_predictor(states, fanout);
+    for (auto _ : st) {
+        st.PauseTiming();
+        auto p = trained;
+        st.ResumeTiming();
+        p.decay_half();
+        st.PauseTiming(); // keep the copy's destruction out of the timing
+        { auto dead = std::move(p); }
+        st.ResumeTiming();
+    }
+    st.SetItemsProcessed(int64_t(st.iterations()) * int64_t(states * fanout));
+    set_working_set(st, size_t(states * fanout) * kMarkovEdgeBytes);
+}
+BENCHMARK(BM_Markov_DecayHalf)->Apply(markov_args)->Unit(benchmark::kMicrosecond);
+
+// ---- LRUCache<uint64_t, uint64_t>: Args {capacity} ----
+
+constexpr size_t kLruEntryBytes = 72; // list node + hash node + bucket, approx.
+
+void lru_args(benchmark::internal::Benchmark* b) {
+    for (int64_t cap : {1 << 8, 1 << 12, 1 << 16, 1 << 20}) b->Arg(cap);
+}
+
+LRUCache<uint64_t, uint64_t> full_lru(uint64_t cap) {
+    LRUCache<uint64_t, uint64_t> c(cap);
+    for (uint64_t k = 0; k < cap; ++k) c.put(k, k);
+    return c;
+}
+
+void BM_LRU_Hit(benchmark::State& st) {
+    const uint64_t cap = uint64_t(st.range(0));
+    auto c = full_lru(cap);
+    FastRng rng;
+    for (auto _ : st) benchmark::DoNotOptimize(c.get(rng.below(cap)));
+    set_working_set(st, cap * kLruEntryBytes);
+}
+BENCHMARK(BM_LRU_Hit)->Apply(lru_args);
+
+void BM_LRU_Miss(benchmark::State& st) {
+    const uint64_t cap = uint64_t(st.range(0));
+    auto c = full_lru(cap);
+    FastRng rng;
+    for (auto _ : st) benchmark::DoNotOptimize(c.get(cap + rng.below(cap)));
+    set_working_set(st, cap * kLruEntryBytes);
+}
+BENCHMARK(BM_LRU_Miss)->Apply(lru_args);
+
+// put of a new key into a full cache: insert at MRU plus eviction of the LRU entry
+void BM_LRU_Evict(benchmark::State& st) {
+    const uint64_t cap = uint64_t(st.range(0));
+    auto c = full_lru(cap);
+    uint64_t next = cap;
+    for (auto _ : st) c.put(next, next), ++next;
+    set_working_set(st, cap * kLruEntryBytes);
+}
+BENCHMARK(BM_LRU_Evict)->Apply(lru_args);
+
+// ---- shard routing: hash % shards, then the shard mutex, as in the sharded wrappers.
+// Args {shards}; the working set is the mutex array ----
+
+void shard_args(benchmark::internal::Benchmark* b) {
+    for (int64_t shards : {8, 1 << 9, 1 << 15, 1 << 21}) b->Arg(shards);
+}
+
+// index computation alone (a runtime modulo); no working set beyond registers
+void BM_ShardRoute(benchmark::State& st) {
+    size_t shards = size_t(st.range(0));
+    benchmark::DoNotOptimize(shards);
+    std::hash<uint64_t> hasher;
+    FastRng rng;
+    for (auto _ : st) benchmark::DoNotOptimize(hasher(rng()) % shards);
+}
+BENCHMARK(BM_ShardRoute)->Arg(8)->Arg(12);
+
+void BM_ShardRouteLock(benchmark::State& st) {
+    const size_t shards = size_t(st.range(0));
+    std::vector<std::mutex> locks(shards);
+    std::hash<uint64_t> hasher;
+    FastRng rng;
+    for (auto _ : st) {
+        std::scoped_lock l(locks[hasher(rng()) % shards]);
+        benchmark::ClobberMemory();
+    }
+    set_working_set(st, shards * sizeof(std::mutex));
+}
+BENCHMARK(BM_ShardRouteLock)->Apply(shard_args);
+
+// ---- Lz4.hpp on JSON-like values of Arg bytes, as CompressedTier sees them ----
+
+std::string json_like(size_t n) {
+    static const char* const words[] = {"\"id\":", "\"user\":", "\"session\"", "\"tags\":[", "true,", "null,"};
+    FastRng rng;
+    std::string s;
+    while (s.size() < n) {
+        s += words[rng.below(6)];
+        s += std::to_string(rng.below(100000));
+        s += ',';
+    }
+    s.resize(n);
+    return s;
+}
+
+void BM_Lz4_Compress(benchmark::State& st) {
+    const std::string in = json_like(size_t(st.range(0)));
+    std::string out(lz4::compress_bound(in.size()), '\0');
+    size_t c = 0;
+    for (auto _ : st) benchmark::DoNotOptimize(c = lz4::compress(in.data(), in.size(), &out[0], out.size()));
+    st.SetBytesProcessed(int64_t(st.iterations()) * int64_t(in.size()));
+    st.counters["ratio"] = double(in.size()) / double(c);
+}
+BENCHMARK(BM_Lz4_Compress)->Arg(256)->Arg(4096);
+
+void BM_Lz4_Decompress(benchmark::State& st) {
+    const std::string in = json_like(size_t(st.range(0)));
+    std::string packed(lz4::compress_bound(in.size()), '\0');
+    packed.resize(lz4::compress(in.data(), in.size(), &packed[0], packed.size()));
+    std::string out(in.size(), '\0');
+    for (auto _ : st) benchmark::DoNotOptimize(lz4::decompress(packed.data(), packed.size(), &out[0], out.size()));
+    st.SetBytesProcessed(int64_t(st.iterations()) * int64_t(in.size()));
+}
+BENCHMARK(BM_Lz4_Decompress)->Arg(256)->Arg(4096);
+
+} // namespace
@@ -0,0 +1,127 @@
+// Key-type x value-size matrix for the sharded caches. The Zipf suite in
+// bm_cache.cpp uses int keys and a one-byte value, which hides hashing, copying
+// and allocation costs; here keys are uint64 or 16/64/256-byte strings and
+// values range from 8 B to 64 KB, fixed or drawn per key from a size
+// distribution. get() copies the value out and put() copies key and value in,
+// as a real caller pays.
+//
+// Args: {value_size}; 0 = ETC distribution, -1 = lognormal distribution.
+// Counters: items_per_second (ops/s), bytes_per_second (key + value bytes moved
+// per op), hit_rate, value_bytes (mean value size over the key space).
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "ShardedLRU.hpp"
+#include "ShardedWTinyLFU.hpp"
+#include "Workloads.hpp"
+
+namespace {
+
+constexpr size_t kCapacity = 1000, kKeySpace = 10000, kShards = 8;
+constexpr size_t kStreamLen = size_t(1) << 20;
+constexpr size_t kMaxValue = 64 << 10;
+
+struct U64Key {
+    using type = uint64_t;
+    static constexpr size_t bytes = sizeof(uint64_t);
+    static type make(uint64_t id) { return id; }
+};
+template <size_t N>
+struct StringKey {
+    using type = std::string;
+    static constexpr size_t bytes = N;
+    // distinct keys sharing a long common suffix, so hashing and compares see all N bytes
+    static type make(uint64_t id) {
+        std::string s = std::to_string(id);
+        s.resize(N, '#');
+        return s;
+    }
+};
+
+struct ShardedLRUKind {
+    template <typename K, typename V> static auto make() { return std::make_unique<ShardedLRU<K, V>>(kCapacity, kShards); }
+};
+struct ShardedWTinyLFUKind {
+    template <typename K, typename V> static auto make() { return std::make_unique<ShardedWTinyLFU<K, V>>(kCapacity, kShards); }
+};
+
+// Per-key value size, fixed for the life of the key as in a real store.
+//  ETC: generalized Pareto (theta 0, sigma 214.476, k 0.348238), the value-size
+//       fit for Facebook's ETC memcached pool (Atikoglu et al., SIGMETRICS 2012).
+//  lognormal: median 1 KB, sigma 1.5, a heavier mid-size mix.
+// Both clamped to [1 B, 64 KB].
+std::vector<size_t> value_sizes(int64_t arg) {
+    std::vector<size_t> sizes(kKeySpace, size_t(std::max<int64_t>(arg, 1)));
+    if (arg > 0) return sizes;
+    std::mt19937_64 rng(7);
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+    std::lognormal_distribution<double> logn(std::log(1024.0), 1.5);
+    for (auto& s : sizes) {
+        const double x = arg == 0 ? 214.476 * (std::pow(1.0 - uni(rng), -0.348238) - 1.0) / 0.348238 : logn(rng);
+        s = size_t(std::clamp(x, 1.0, double(kMaxValue)));
+    }
+    return sizes;
+}
+
+template <typename Kind, typename KeyT>
+void BM_KV(benchmark::State& st) {
+    using K = typename KeyT::type;
+    const auto sizes = value_sizes(st.range(0));
+    // values are built up front: one per key for a distribution, one shared for a
+    // fixed size (64 KB x key space would not fit)
+    const bool fixed = st.range(0) > 0;
+    std::vector<K> keys;
+    std::vector<std::string> values;
+    keys.reserve(kKeySpace);
+    double mean_value = 0;
+    for (uint64_t id = 0; id < kKeySpace; ++id) {
+        keys.push_back(KeyT::make(id));
+        if (!fixed || id == 0) values.emplace_back(sizes[id], char('a' + id % 26));
+        mean_value += double(sizes[id]);
+    }
+    mean_value /= double(kKeySpace);
+    auto value_of = [&](uint32_t id) -> const std::string& { return values[fixed ? 0 : id]; };
+    const auto ids = pregenerate_keys<uint32_t>(kStreamLen, make_workload("zipf:n=10000,s=0.99", 123));
+
+    auto cache = Kind::template make<K, std::string>();
+    for (size_t i = 0; i < 4 * kCapacity; ++i) { // warm
+        const uint32_t id = ids[i];
+        if (!cache->get(keys[id])) cache->put(keys[id], value_of(id));
+    }
+
+    size_t pos = 0, hits = 0, misses = 0;
+    uint64_t bytes = 0;
+    for (auto _ : st) {
+        const uint32_t id = ids[pos++ & (kStreamLen - 1)];
+        auto v = cache->get(keys[id]);
+        if (v) ++hits;
+        else { ++misses; cache->put(keys[id], value_of(id)); }
+        benchmark::DoNotOptimize(v);
+        bytes += KeyT::bytes + sizes[id];
+    }
+    st.SetItemsProcessed(int64_t(st.iterations()));
+    st.SetBytesProcessed(int64_t(bytes));
+    st.counters["hit_rate"] = double(hits) / double(std::max<size_t>(1, hits + misses));
+    st.counters["value_bytes"] = mean_value;
+    st.SetLabel(st.range(0) == 0 ? "etc" : st.range(0) < 0 ? "lognormal" : "fixed");
+}
+
+void value_args(benchmark::internal::Benchmark* b) {
+    for (int64_t v : {8, 64, 512, 4096, 65536, 0, -1}) b->Arg(v);
+}
+
+#define KV_BENCHMARKS(Kind)                                                  \
+    BENCHMARK_TEMPLATE(BM_KV, Kind, U64Key)->Apply(value_args);              \
+    BENCHMARK_TEMPLATE(BM_KV, Kind, StringKey<16>)->Apply(value_args);       \
+    BENCHMARK_TEMPLATE(BM_KV, Kind, StringKey<64>)->Apply(value_args);       \
+    BENCHMARK_TEMPLATE(BM_KV, Kind, StringKey<256>)->Apply(value_args);
+
+KV_BENCHMARKS(ShardedLRUKind)
+KV_BENCHMARKS(ShardedWTinyLFUKind)
+
+} // namespace
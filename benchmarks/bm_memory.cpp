@@ -0,0 +1,186 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <type_traits>
+#include "LRUCache.hpp"
+#include "LFUCache.hpp"
+#include "TinyLFUAdmittingLRU.hpp"
+#include "ShardedLRU.hpp"
+#include "ShardedWTinyLFU.hpp"
+#include "PredictiveShardedCache.hpp"
+#include "ShardedSlabCache.hpp"
+#include "CountMinSketch.hpp"
+#include "AllocCounter.hpp"
+
+// Memory footprint per policy, measured with the counting operator new in
+// AllocCounter.cpp. Each run constructs a cache, fills it to capacity, then
+// churns 4x capacity get-or-put ops over a keyspace of 2x capacity so eviction,
+// admission and prediction state reach steady state. Byte counters are the
+// requested sizes; malloc's own per-block overhead is not included.
+//
+// Counters:
+//   total_bytes     live bytes held by the cache at steady state
+//   fixed_bytes     bytes right after construction (shard tables, sketches)
+//   peak_bytes      high-water mark during fill + churn
+//   bytes_per_entry total_bytes / entries
+//   meta_per_entry  (total - fixed - entries * payload) / entries, where payload is
+//                   sizeof(Key) + sizeof(Value) + heap owned by one key/value
+//   sketch_bytes    Count-Min Sketch memory across shards (TinyLFU-based caches)
+//   predictor_bytes Markov predictor state (PredictiveShardedCache only)
+//
+// ShardedSlabCache takes a byte budget; it gets the chunk bytes of `cap`
+// entries, so it holds somewhat fewer than cap after class rounding.
+
+static constexpr size_t kShards = 8;
+static constexpr size_t kCmsWidth = 4096, kCmsDepth = 4;
+
+template <typename T> T make_key(uint64_t i);
+template <> uint64_t make_key<uint64_t>(uint64_t i) { return i; }
+template <> std::string make_key<std::string>(uint64_t i) {
+    std::string s = std::to_string(i);
+    s.resize(32, '#'); // 32-byte keys, past the small-string buffer
+    return s;
+}
+
+template <typename T> T make_value();
+template <> uint64_t make_value<uint64_t>() { return 42; }
+template <> std::string make_value<std::string>() { return std::string(100, 'v'); }
+
+static int64_t live_bytes() { return alloc_counter::thread_snapshot().live_bytes(); }
+
+struct LRUKind {
+    template <typename K, typename V> static auto make(size_t cap) { return std::make_unique<LRUCache<K, V>>(cap); }
+    static constexpr size_t sketches = 0;
+};
+struct LFUKind {
+    template <typename K, typename V> static auto make(size_t cap) { return std::make_unique<LFUCache<K, V>>(cap); }
+    static constexpr size_t sketches = 0;
+};
+struct TinyLFUKind {
+    template <typename K, typename V> static auto make(size_t cap) {
+        return std::make_unique<TinyLFUAdmittingLRU<K, V>>(cap, kCmsWidth, kCmsDepth);
+    }
+    static constexpr size_t sketches = 1;
+};
+struct ShardedLRUKind {
+    template <typename K, typename V> static auto make(size_t cap) { return std::make_unique<ShardedLRU<K, V>>(cap, kShards); }
+    static constexpr size_t sketches = 0;
+};
+struct ShardedWTinyLFUKind {
+    template <typename K, typename V> static auto make(size_t cap) {
+        return std::make_unique<ShardedWTinyLFU<K, V>>(cap, kShards, kCmsWidth, kCmsDepth);
+    }
+    static constexpr size_t sketches = kShards;
+};
+struct PredictiveKind {
+    template <typename K, typename V> static auto make(size_t cap) {
+        typename PredictiveShardedCache<K, V>::Options opt;
+        opt.shards = kShards; opt.prefetch_topk = 2; opt.min_trans_count = 2; opt.min_trans_prob = 0.1;
+        return std::make_unique<PredictiveShardedCache<K, V>>(cap, opt);
+    }
+    static constexpr size_t sketches = kShards;
+};
+
+struct SlabKind {
+    template <typename K, typename V> static auto make(size_t cap) {
+        std::string rec;
+        SnapshotCodec<K>{}.encode(rec, make_key<K>(cap));
+        SnapshotCodec<V>{}.encode(rec, make_value<V>());
+        const size_t bytes = cap * (sizeof(SlabItem) + rec.size()) * 5 / 4;
+        const size_t page = std::clamp<size_t>(bytes / kShards / 16, 4096, size_t(1) << 20);
+        return std::make_unique<ShardedSlabCache<K, V>>(std::max(bytes, kShards * page), kShards, page);
+    }
+    static constexpr size_t sketches = 0;
+};
+
+struct Footprint {
+    int64_t fixed = 0, steady = 0, peak = 0;
+    size_t entries = 0;
+};
+
+template <typename Kind, typename K, typename V>
+static Footprint measure(size_t cap) {
+    Footprint f;
+    alloc_counter::reset_peak();
+    const int64_t before = live_bytes();
+    {
+        auto cache = Kind::template make<K, V>(cap);
+        f.fixed = live_bytes() - before;
+
+        const V value = make_value<V>();
+        for (size_t i = 0; i < cap; ++i) cache->put(make_key<K>(i), value);
+
+        std::mt19937_64 rng(123);
+        std::uniform_int_distribution<uint64_t> uni(0, 2 * cap - 1);
+        for (size_t i = 0; i < 4 * cap; ++i) {
+            K k = make_key<K>(uni(rng));
+            if (!cache->get(k)) cache->put(k, value);
+        }
+        f.entries = cache->size();
+        f.steady = live_bytes() - before;
+        f.peak = alloc_counter::thread_snapshot().peak_live_bytes - before;
+    }
+    return f;
+}
+
+template <typename Kind, typename K, typename V>
+static void BM_Memory(benchmark::State& st) {
+    const size_t cap = st.range(0);
+
+    // heap owned by one key/value pair, beyond their sizeof
+    int64_t payload_heap;
+    {
+        const int64_t b = live_bytes();
+        K k = make_key<K>(cap); V v = make_value<V>();
+        payload_heap = live_bytes() - b;
+        benchmark::DoNotOptimize(k); benchmark::DoNotOptimize(v);
+    }
+    int64_t sketch_bytes;
+    {
+        const int64_t b = live_bytes();
+        CountMinSketch cms(kCmsWidth, kCmsDepth);
+        sketch_bytes = (live_bytes() - b) * int64_t(Kind::sketches);
+        benchmark::DoNotOptimize(cms);
+    }
+
+    Footprint f;
+    for (auto _ : st) f = measure<Kind, K, V>(cap);
+
+    const double entries = f.entries ? double(f.entries) : 1.0;
+    const double payload = double(sizeof(K) + sizeof(V)) + double(payload_heap);
+    st.counters["entries"] = double(f.entries);
+    st.counters["total_bytes"] = double(f.steady);
+    st.counters["fixed_bytes"] = double(f.fixed);
+    st.counters["peak_bytes"] = double(f.peak);
+    st.counters["bytes_per_entry"] = double(f.steady) / entries;
+    st.counters["meta_per_entry"] = (double(f.steady - f.fixed) - entries * payload) / entries;
+    st.counters["sketch_bytes"] = double(sketch_bytes);
+    if constexpr (std::is_same_v<Kind, PredictiveKind>) {
+        // same churn on the base cache; the difference is the predictors
+        const Footprint base = measure<ShardedWTinyLFUKind, K, V>(cap);
+        st.counters["predictor_bytes"] = double(f.steady - base.steady);
+    }
+}
+
+static void capacities(benchmark::internal::Benchmark* b) {
+    for (int64_t cap : {1000, 10000, 100000, 1000000}) b->Arg(cap);
+    b->Iterations(1)->Unit(benchmark::kMillisecond);
+}
+
+#define MEMORY_BENCHMARKS(Kind)                                              \
+    BENCHMARK_TEMPLATE(BM_Memory, Kind, uint64_t, uint64_t)->Apply(capacities);       \
+    BENCHMARK_TEMPLATE(BM_Memory, Kind, uint64_t, std::string)->Apply(capacities);    \
+    BENCHMARK_TEMPLATE(BM_Memory, Kind, std::string, std::string)->Apply(capacities)
+
+MEMORY_BENCHMARKS(LRUKind);
+MEMORY_BENCHMARKS(LFUKind);
+MEMORY_BENCHMARKS(TinyLFUKind);
+MEMORY_BENCHMARKS(ShardedLRUKind);
+MEMORY_BENCHMARKS(ShardedWTinyLFUKind);
+MEMORY_BENCHMARKS(PredictiveKind);
+MEMORY_BENCHMARKS(SlabKind);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Built-in per-shard counters of the sharded caches. Each shard owns one
+// cache-line-aligned ShardCounters block that is written only under that shard's
+// lock, so an update is a relaxed load and store (no locked read-modify-write)
+// and shards never share a line. Reads need no lock: stats() and the metrics
+// exporter load the atomics while the cache keeps running.
+//
+// Building with PCACHE_DISABLE_STATS (CMake option of the same name) turns every
+// counter into an empty no-op and kStatsEnabled into false, so the bookkeeping
+// behind it compiles away too.
+#if defined(PCACHE_DISABLE_STATS)
+inline constexpr bool kStatsEnabled = false;
+
+class ShardCounter {
+public:
+    void add(uint64_t = 1) {}
+    void set(uint64_t) {}
+    uint64_t load() const { return 0; }
+};
+#else
+inline constexpr bool kStatsEnabled = true;
+
+class ShardCounter {
+public:
+    void add(uint64_t n = 1) { v_.store(v_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    void set(uint64_t n) { v_.store(n, std::memory_order_relaxed); }
+    uint64_t load() const { return v_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> v_{0};
+};
+#endif
+
+struct alignas(64) ShardCounters {
+    ShardCounter hits, misses;
+    ShardCounter puts;                  // put() calls, including updates of present keys
+    ShardCounter evictions;
+    ShardCounter admitted, rejected;    // TinyLFU admission of new keys into a full shard
+    ShardCounter prefetch_issued;       // predicted keys inserted or handed to the prefetcher
+    ShardCounter prefetch_used;         // prefetched entries later hit by get()
+    ShardCounter prefetch_wasted;       // prefetched entries evicted or refused before any hit
+    ShardCounter predictor_states, predictor_edges;   // gauges
+    ShardCounter decay_runs;
+    ShardCounter size;                  // gauge: entries in the shard
+};
+
+// Plain copy of one shard's counters, or their sum over shards.
+struct CounterSnapshot {
+    uint64_t hits = 0, misses = 0, puts = 0, evictions = 0, admitted = 0, rejected = 0;
+    uint64_t prefetch_issued = 0, prefetch_used = 0, prefetch_wasted = 0;
+    uint64_t predictor_states = 0, predictor_edges = 0, decay_runs = 0;
+    uint64_t size = 0;
+
+    static CounterSnapshot of(const ShardCounters& c) {
+        CounterSnapshot s;
+        s.hits = c.hits.load();
+        s.misses = c.misses.load();
+        s.puts = c.puts.load();
+        s.evictions = c.evictions.load();
+        s.admitted = c.admitted.load();
+        s.rejected = c.rejected.load();
+        s.prefetch_issued = c.prefetch_issued.load();
+        s.prefetch_used = c.prefetch_used.load();
+        s.prefetch_wasted = c.prefetch_wasted.load();
+        s.predictor_states = c.predictor_states.load();
+        s.predictor_edges = c.predictor_edges.load();
+        s.decay_runs = c.decay_runs.load();
+        s.size = c.size.load();
+        return s;
+    }
+
+    CounterSnapshot& operator+=(const CounterSnapshot& o) {
+        hits += o.hits;
+        misses += o.misses;
+        puts += o.puts;
+        evictions += o.evictions;
+        admitted += o.admitted;
+        rejected += o.rejected;
+        prefetch_issued += o.prefetch_issued;
+        prefetch_used += o.prefetch_used;
+        prefetch_wasted += o.prefetch_wasted;
+        predictor_states += o.predictor_states;
+        predictor_edges += o.predictor_edges;
+        decay_runs += o.decay_runs;
+        size += o.size;
+        return *this;
+    }
+
+    // Activity since an earlier snapshot of the same counters; gauges keep their current value.
+    CounterSnapshot since(const CounterSnapshot& e) const {
+        CounterSnapshot d = *this;
+        d.hits -= e.hits;
+        d.misses -= e.misses;
+        d.puts -= e.puts;
+        d.evictions -= e.evictions;
+        d.admitted -= e.admitted;
+        d.rejected -= e.rejected;
+        d.prefetch_issued -= e.prefetch_issued;
+        d.prefetch_used -= e.prefetch_used;
+        d.prefetch_wasted -= e.prefetch_wasted;
+        d.decay_runs -= e.decay_runs;
+        return d;
+    }
+
+    double hit_rate() const { return hits + misses ? double(hits) / double(hits + misses) : 0.0; }
+};
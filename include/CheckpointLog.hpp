@@ -0,0 +1,353 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Snapshot.hpp"
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+struct CheckpointLogOptions {
+    // The writer commits pending records this often; a crash loses at most about
+    // this much (plus the sync) of acknowledged changes.
+    std::chrono::milliseconds group_commit_interval{5};
+    bool sync = true;                                 // fdatasync after each group commit
+    uint64_t compact_after_bytes = uint64_t(256) << 20;   // log bytes that trigger a checkpoint; 0: only explicit ones
+};
+
+// Append-only change log of a sharded cache, one directory per cache:
+//
+//   dir/snapshot      last checkpoint, in the Snapshot.hpp format, with the log
+//                     position (LSN) of every shard at the time it was taken
+//   dir/log.<gen>     log segments, oldest generation first
+//
+// Callers append records under their shard lock. Each shard has its own
+// buffer and LSN sequence, so appending never contends across shards. A
+// background writer swaps out all buffers every group_commit_interval and
+// writes them as one group: a single write and a single fdatasync per commit.
+//
+// Record: u32 body length, u64 checksum of the body, body =
+// { u32 shard, u64 lsn, u8 op, key [, value] }. op is kPut (the key's value is
+// now `value`) or kErase (the key left the cache: eviction or erase()).
+//
+// Compaction: rotate() starts a new segment. A snapshot taken after that covers
+// every record in the older segments, so once the snapshot is written they are
+// deleted. Automatic compactions run on a thread of their own, so group commits
+// carry on while the snapshot is written. Recovery loads the snapshot, then
+// replays, per shard, the records with an LSN above the snapshot's. Replay
+// stops at the first torn or corrupt record of a segment.
+//
+// POSIX only; the constructor throws std::runtime_error elsewhere or when the
+// directory cannot be used. Writer I/O errors stop logging and show in stats().
+template <typename Key, typename Value>
+class CheckpointLog {
+public:
+    enum Op : uint8_t { kPut = 1, kErase = 2 };
+
+    using KeyEncoder = std::function<void(std::string&, const Key&)>;
+    using ValueEncoder = std::function<void(std::string&, const Value&)>;
+
+    struct Stats {
+        uint64_t records = 0, bytes = 0, groups = 0, compactions = 0;
+        uint64_t generation = 0;    // current segment
+        std::string error;          // first writer or compaction error; logging stops on a writer error
+    };
+
+    // next_lsn[i]: first LSN to hand out for shard i, above anything already on disk.
+    // compact runs on the compaction thread once compact_after_bytes have been logged.
+    CheckpointLog(const std::string& dir, size_t shards, std::vector<uint64_t> next_lsn, KeyEncoder ek,
+                  ValueEncoder ev, const CheckpointLogOptions& opt, std::function<void()> compact)
+        : dir_(dir), opt_(opt), shards_(shards), encode_key_(std::move(ek)), encode_value_(std::move(ev)),
+          compact_(std::move(compact)) {
+#if defined(__unix__) || defined(__APPLE__)
+        for (size_t i = 0; i < shards; ++i) shards_[i].lsn = i < next_lsn.size() ? next_lsn[i] : 1;
+        const auto segs = segments(dir_);
+        gen_ = segs.empty() ? 1 : segs.back().first + 1;
+        open_segment();
+        writer_ = std::thread([this] { run(); });
+        if (compact_ && opt_.compact_after_bytes) compactor_ = std::thread([this] { run_compactions(); });
+#else
+        (void)next_lsn;
+        throw std::runtime_error("checkpoint log: needs POSIX file I/O");
+#endif
+    }
+
+    ~CheckpointLog() {
+        {
+            std::scoped_lock l(mu_);
+            compact_stop_ = true;
+        }
+        compact_cv_.notify_all();
+        if (compactor_.joinable()) compactor_.join();   // a running compaction still needs the writer
+        {
+            std::scoped_lock l(mu_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        if (writer_.joinable()) writer_.join();
+#if defined(__unix__) || defined(__APPLE__)
+        if (fd_ >= 0) ::close(fd_);
+#endif
+    }
+
+    CheckpointLog(const CheckpointLog&) = delete;
+    CheckpointLog& operator=(const CheckpointLog&) = delete;
+
+    // Call with the cache's lock for `shard` held.
+    void append_put(size_t shard, const Key& k, const Value& v) { append(shard, kPut, k, &v); }
+    void append_erase(size_t shard, const Key& k) { append(shard, kErase, k, nullptr); }
+
+    // Last LSN handed out for shard; call with its lock held (snapshots record it).
+    uint64_t position(size_t shard) const { return shards_[shard].lsn - 1; }
+
+    // Blocks until every record appended so far is committed. Returns the
+    // generation records appended from now on go to; older segments are complete.
+    uint64_t rotate() { return commit(/*rotate=*/true); }
+    void flush() { commit(/*rotate=*/false); }
+
+    // Deletes the segments before generation `gen`, once a snapshot covers them
+    // and is durable (SnapshotWriter::write syncs the directory after its rename).
+    void drop_segments_before(uint64_t gen) {
+        for (const auto& [g, path] : segments(dir_))
+            if (g < gen) std::filesystem::remove(path);
+        snapshot_detail::sync_dir(dir_);
+        std::scoped_lock l(mu_);
+        ++stats_.compactions;
+        bytes_since_compact_ = 0;
+    }
+
+    Stats stats() const {
+        std::scoped_lock l(mu_);
+        Stats s = stats_;
+        s.generation = gen_;
+        return s;
+    }
+
+    // Log segments in dir as (generation, path), oldest first.
+    static std::vector<std::pair<uint64_t, std::string>> segments(const std::string& dir) {
+        std::vector<std::pair<uint64_t, std::string>> out;
+        std::error_code ec;
+        for (const auto& e : std::filesystem::directory_iterator(dir, ec)) {
+            const std::string name = e.path().filename().string();
+            if (name.rfind("log.", 0) != 0 || name.size() == 4) continue;
+            if (name.find_first_not_of("0123456789", 4) != std::string::npos) continue;
+            out.emplace_back(std::stoull(name.substr(4)), e.path().string());
+        }
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+
+    // Calls apply(shard, lsn, op, reader) for every intact record of every segment
+    // in dir, oldest first; reader is positioned at the key. Stops a segment at its
+    // first torn or corrupt record.
+    template <typename Apply>
+    static void replay(const std::string& dir, Apply&& apply) {
+        for (const auto& seg : segments(dir)) {
+            std::FILE* f = std::fopen(seg.second.c_str(), "rb");
+            if (!f) throw std::runtime_error("checkpoint log: cannot open " + seg.second);
+            std::string data;
+            char buf[1 << 16];
+            for (size_t n; (n = std::fread(buf, 1, sizeof(buf), f)) > 0;) data.append(buf, n);
+            std::fclose(f);
+
+            SnapshotReader in(data.data(), data.size());
+            constexpr size_t kHead = sizeof(uint32_t) + sizeof(uint64_t);
+            size_t off = 0;
+            while (data.size() - off >= kHead) {
+                const uint32_t len = in.pod<uint32_t>();
+                const uint64_t sum = in.pod<uint64_t>();
+                if (data.size() - off - kHead < len) break;   // torn tail
+                const char* body = in.bytes(len);
+                if (snapshot_detail::checksum(body, len) != sum) break;
+                SnapshotReader rec(body, len);
+                const uint32_t shard = rec.pod<uint32_t>();
+                const uint64_t lsn = rec.pod<uint64_t>();
+                const uint8_t op = rec.pod<uint8_t>();
+                apply(size_t(shard), lsn, Op(op), rec);
+                off += kHead + len;
+            }
+        }
+    }
+
+private:
+    struct alignas(64) ShardBuffer {
+        std::mutex mu;          // with the writer's swap only
+        std::string buf;
+        uint64_t lsn = 1;       // next LSN; guarded by the cache's shard lock
+    };
+
+    void append(size_t shard, Op op, const Key& k, const Value* v) {
+        ShardBuffer& s = shards_[shard];
+        const uint64_t lsn = s.lsn++;
+        std::scoped_lock l(s.mu);
+        std::string& b = s.buf;
+        const size_t head = b.size();
+        b.append(sizeof(uint32_t) + sizeof(uint64_t), '\0');   // length and checksum, patched below
+        const size_t body = b.size();
+        snapshot_detail::append_pod(b, uint32_t(shard));
+        snapshot_detail::append_pod(b, lsn);
+        snapshot_detail::append_pod(b, uint8_t(op));
+        encode_key_(b, k);
+        if (v) encode_value_(b, *v);
+        const uint32_t len = uint32_t(b.size() - body);
+        const uint64_t sum = snapshot_detail::checksum(b.data() + body, len);
+        std::memcpy(&b[head], &len, sizeof(len));
+        std::memcpy(&b[head + sizeof(len)], &sum, sizeof(sum));
+    }
+
+    uint64_t commit(bool rotate) {
+        std::unique_lock l(mu_);
+        const uint64_t ticket = ++requested_;
+        if (rotate) rotate_requested_ = true;
+        cv_.notify_all();
+        done_cv_.wait(l, [&] { return completed_ >= ticket || stop_; });
+        return gen_;
+    }
+
+    void run() {
+        std::unique_lock l(mu_);
+        while (!stop_) {
+            cv_.wait_for(l, opt_.group_commit_interval, [&] { return stop_ || requested_ > completed_; });
+            const uint64_t ticket = requested_;
+            const bool rotate = rotate_requested_;
+            rotate_requested_ = false;
+            l.unlock();
+            drain();
+            if (rotate) next_segment();
+            const bool compact = compact_ && opt_.compact_after_bytes && bytes_since_compact_ >= opt_.compact_after_bytes;
+            l.lock();
+            completed_ = ticket;
+            done_cv_.notify_all();
+            if (compact && !compact_pending_) {
+                compact_pending_ = true;
+                compact_cv_.notify_one();
+            }
+        }
+        l.unlock();
+        drain();
+        done_cv_.notify_all();
+    }
+
+    // Compaction thread: runs compact_ whenever the writer asks for it. compact_
+    // calls rotate(), which the writer serves meanwhile.
+    void run_compactions() {
+        std::unique_lock l(mu_);
+        for (;;) {
+            compact_cv_.wait(l, [&] { return compact_stop_ || compact_pending_; });
+            if (compact_stop_) return;
+            l.unlock();
+            try {
+                compact_();
+            } catch (const std::exception& e) {
+                std::scoped_lock el(mu_);
+                if (stats_.error.empty()) stats_.error = std::string("compaction: ") + e.what();
+            }
+            l.lock();
+            compact_pending_ = false;   // asked again only once compact_after_bytes more are logged
+        }
+    }
+
+    // Writer thread only: one group commit of everything pending.
+    void drain() {
+        std::string group;
+        uint64_t records = 0;
+        for (auto& s : shards_) {
+            std::scoped_lock l(s.mu);
+            if (s.buf.empty()) continue;
+            if (group.empty()) {
+                group.swap(s.buf);
+            } else {
+                group += s.buf;
+                s.buf.clear();
+            }
+        }
+        if (group.empty() || failed_) return;
+        for (size_t off = 0; off < group.size(); ++records) {   // count records for stats
+            uint32_t len;
+            std::memcpy(&len, group.data() + off, sizeof(len));
+            off += sizeof(uint32_t) + sizeof(uint64_t) + len;
+        }
+#if defined(__unix__) || defined(__APPLE__)
+        bool ok = true;
+        for (size_t off = 0; ok && off < group.size();) {
+            const ssize_t w = ::write(fd_, group.data() + off, group.size() - off);
+            ok = w > 0;
+            if (ok) off += size_t(w);
+        }
+#if defined(__linux__)
+        if (ok && opt_.sync) ok = ::fdatasync(fd_) == 0;
+#else
+        if (ok && opt_.sync) ok = ::fsync(fd_) == 0;
+#endif
+        std::scoped_lock l(mu_);
+        if (!ok) {
+            failed_ = true;
+            if (stats_.error.empty()) stats_.error = "cannot write log segment " + std::to_string(gen_);
+            return;
+        }
+#endif
+        stats_.records += records;
+        stats_.bytes += group.size();
+        ++stats_.groups;
+        bytes_since_compact_ += group.size();
+    }
+
+    uint64_t next_segment() {
+#if defined(__unix__) || defined(__APPLE__)
+        ::close(fd_);
+#endif
+        std::scoped_lock l(mu_);
+        ++gen_;
+        open_segment();
+        return gen_;
+    }
+
+    void open_segment() {
+#if defined(__unix__) || defined(__APPLE__)
+        const std::string path = dir_ + "/log." + std::to_string(gen_);
+        fd_ = ::open(path.c_str(), O_CREAT | O_WRONLY | O_APPEND, 0644);
+        // the segment's directory entry must be durable before records committed to it are
+        if (fd_ >= 0 && !snapshot_detail::sync_dir(dir_)) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        if (fd_ < 0) {
+            failed_ = true;
+            if (stats_.error.empty()) stats_.error = "cannot open " + path;
+            if (!writer_.joinable()) throw std::runtime_error("checkpoint log: cannot open " + path);
+        }
+#endif
+    }
+
+    std::string dir_;
+    CheckpointLogOptions opt_;
+    std::vector<ShardBuffer> shards_;
+    KeyEncoder encode_key_;
+    ValueEncoder encode_value_;
+    std::function<void()> compact_;
+
+    mutable std::mutex mu_;         // everything below
+    std::condition_variable cv_, done_cv_, compact_cv_;
+    uint64_t requested_ = 0, completed_ = 0;
+    bool rotate_requested_ = false;
+    bool stop_ = false;
+    bool compact_pending_ = false, compact_stop_ = false;
+    uint64_t gen_ = 1;
+    Stats stats_;
+    std::atomic<uint64_t> bytes_since_compact_{0};
+    bool failed_ = false;           // writer thread only, after construction
+    int fd_ = -1;                   // writer thread only, after construction
+    std::thread writer_, compactor_;
+};
@@ -0,0 +1,281 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Lz4.hpp"
+#include "SlabAllocator.hpp"
+#include "Snapshot.hpp"
+
+struct CompressedTierOptions {
+    size_t shards = 16;
+    size_t page_bytes = size_t(1) << 20;   // slab page; the budget should hold many per shard
+    // Entries whose compressed form saves less than this fraction are stored as is.
+    double min_saving = 0.125;
+    // Bypass: once a shard's recent entries save less than min_saving on average,
+    // only one put in 2^bypass_sample_shift tries to compress, until they save again.
+    unsigned bypass_sample_shift = 4;
+};
+
+// Compressed victim tier in RAM (see TieredCache.hpp), with its own byte budget.
+// put() encodes the entry with the key and value codecs, compresses it with the
+// built-in LZ4-format codec (Lz4.hpp) and stores it in a slab chunk
+// (SlabAllocator.hpp); get() copies the chunk out under the shard lock and
+// decompresses outside it. Per shard:
+//
+//   - A SlabAllocator of budget_bytes / shards. When a class is out of chunks
+//     the least recently used entry of that class is evicted; a class with no
+//     pages at all takes one from the class with the most.
+//   - An index from key hash to chunk. The key is stored with the value and
+//     checked on get(), so a hash collision reads as a miss.
+//   - An average of the saving of recent compressions. Incompressible data
+//     (already compressed media, random bytes) makes it drop below min_saving,
+//     and the shard then skips compression for most puts and stores the
+//     encoded entry as is, paying the CPU only on a sample.
+//
+// Same interface as DiskTier, so TieredCache takes either.
+template <typename Key, typename Value, typename KeyCodec = SnapshotCodec<Key>,
+          typename ValueCodec = SnapshotCodec<Value>>
+class CompressedTier {
+public:
+    struct Stats {
+        uint64_t entries = 0;
+        uint64_t budget_bytes = 0, reserved_bytes = 0;   // slab pages allocated, at most the budget
+        uint64_t raw_bytes = 0;       // encoded size of the stored entries
+        uint64_t stored_bytes = 0;    // their size in the slabs, with headers, before chunk rounding
+        uint64_t hits = 0, misses = 0;
+        uint64_t evictions = 0;       // entries evicted for space, in their class or with a moved page
+        uint64_t compressed = 0;      // puts stored compressed
+        uint64_t stored_raw = 0;      // puts stored as is: incompressible, or skipped by the bypass
+        uint64_t bypassed = 0;        // puts the bypass did not try to compress
+        uint64_t too_large = 0;       // puts larger than a slab page
+        double ratio() const { return stored_bytes ? double(raw_bytes) / double(stored_bytes) : 1.0; }
+    };
+
+    CompressedTier(uint64_t budget_bytes, const CompressedTierOptions& opt = CompressedTierOptions{},
+                   const KeyCodec& kc = KeyCodec{}, const ValueCodec& vc = ValueCodec{})
+        : opt_(opt), kc_(kc), vc_(vc), budget_(budget_bytes) {
+        if (opt.shards == 0) throw std::invalid_argument("shards must be > 0");
+        if (budget_bytes / opt.shards < 2 * opt.page_bytes)
+            throw std::invalid_argument("budget_bytes must hold 2 slab pages per shard");
+        shards_.reserve(opt.shards);
+        for (size_t i = 0; i < opt.shards; ++i)
+            shards_.push_back(std::make_unique<Shard>(budget_bytes / opt.shards, opt.page_bytes));
+    }
+
+    CompressedTier(const CompressedTier&) = delete;
+    CompressedTier& operator=(const CompressedTier&) = delete;
+
+    void put(const Key& key, const Value& value) {
+        std::string rec;
+        kc_.encode(rec, key);
+        vc_.encode(rec, value);
+        const uint64_t h = hasher_(key);
+        Shard& s = *shards_[h % shards_.size()];
+
+        std::string packed;   // u32 raw size + LZ4 block, if worth it
+        const uint32_t saving = s.saving.load(std::memory_order_relaxed);
+        const bool bypass = saving < min_saving_fixed() &&
+                            (s.puts.fetch_add(1, std::memory_order_relaxed) & ((1u << opt_.bypass_sample_shift) - 1));
+        if (!bypass) {
+            packed.resize(4 + lz4::compress_bound(rec.size()));
+            const uint32_t raw = uint32_t(rec.size());
+            std::memcpy(&packed[0], &raw, 4);
+            packed.resize(4 + lz4::compress(rec.data(), rec.size(), &packed[4], packed.size() - 4));
+            const double ratio = rec.empty() ? 1.0 : double(packed.size()) / double(rec.size());
+            const uint32_t now = uint32_t(std::max(0.0, 1.0 - ratio) * 1024);
+            s.saving.store((saving * 15 + now) / 16, std::memory_order_relaxed);   // about the last 16 attempts
+            if (now < min_saving_fixed()) packed.clear();
+        }
+        const bool compressed = !packed.empty();
+        const std::string& payload = compressed ? packed : rec;
+
+        std::scoped_lock l(s.mu);
+        remove(s, h);
+        const int cls = s.slab.class_for(sizeof(SlabItem) + payload.size());
+        if (cls < 0) {
+            ++s.too_large;
+            return;
+        }
+        char* chunk = allocate(s, cls);
+        if (!chunk) {
+            ++s.too_large;
+            return;
+        }
+        SlabItem* it = new (chunk) SlabItem{nullptr, nullptr, h, uint32_t(payload.size()), uint16_t(cls),
+                                            uint16_t(compressed ? kCompressed : 0)};
+        std::memcpy(it->data(), payload.data(), payload.size());
+        s.lru.push_front(it);
+        s.index.emplace(h, it);
+        s.raw_bytes += rec.size();
+        s.stored_bytes += sizeof(SlabItem) + payload.size();
+        ++(compressed ? s.compressed : s.stored_raw);
+        if (bypass) ++s.bypassed;
+    }
+
+    std::optional<Value> get(const Key& key) {
+        const uint64_t h = hasher_(key);
+        Shard& s = *shards_[h % shards_.size()];
+        std::string payload;
+        bool compressed;
+        {
+            std::scoped_lock l(s.mu);
+            auto f = s.index.find(h);
+            if (f == s.index.end()) {
+                ++s.misses;
+                return std::nullopt;
+            }
+            SlabItem* it = f->second;
+            s.lru.touch(it);
+            payload.assign(it->data(), it->size);
+            compressed = it->flags & kCompressed;
+        }
+        std::string raw;
+        if (compressed) {
+            uint32_t n;
+            std::memcpy(&n, payload.data(), 4);
+            raw.resize(n);
+            if (!lz4::decompress(payload.data() + 4, payload.size() - 4, raw.data(), n)) return miss(s);
+        } else {
+            raw.swap(payload);
+        }
+        try {
+            SnapshotReader in(raw.data(), raw.size());
+            if (!(kc_.decode(in) == key)) return miss(s);   // another key with the same hash
+            std::optional<Value> v(vc_.decode(in));
+            s.hits.fetch_add(1, std::memory_order_relaxed);
+            return v;
+        } catch (const std::runtime_error&) {
+            return miss(s);
+        }
+    }
+
+    std::vector<std::optional<Value>> get_batch(const std::vector<Key>& keys) {
+        std::vector<std::optional<Value>> out;
+        out.reserve(keys.size());
+        for (const auto& k : keys) out.push_back(get(k));
+        return out;
+    }
+
+    bool erase(const Key& key) {
+        const uint64_t h = hasher_(key);
+        Shard& s = *shards_[h % shards_.size()];
+        std::scoped_lock l(s.mu);
+        return remove(s, h);
+    }
+
+    size_t size() {
+        size_t n = 0;
+        for (auto& sp : shards_) {
+            Shard& s = *sp;
+            std::scoped_lock l(s.mu);
+            n += s.index.size();
+        }
+        return n;
+    }
+
+    Stats stats() {
+        Stats st;
+        st.budget_bytes = budget_;
+        for (auto& sp : shards_) {
+            Shard& s = *sp;
+            std::scoped_lock l(s.mu);
+            st.entries += s.index.size();
+            st.reserved_bytes += s.slab.reserved_bytes();
+            st.raw_bytes += s.raw_bytes;
+            st.stored_bytes += s.stored_bytes;
+            st.misses += s.misses + s.bad.load(std::memory_order_relaxed);
+            st.hits += s.hits.load(std::memory_order_relaxed);
+            st.evictions += s.evictions;
+            st.compressed += s.compressed;
+            st.stored_raw += s.stored_raw;
+            st.bypassed += s.bypassed;
+            st.too_large += s.too_large;
+        }
+        return st;
+    }
+
+private:
+    static constexpr uint16_t kCompressed = 1;
+
+    struct alignas(64) Shard {
+        Shard(size_t budget, size_t page) : slab(budget, page), lru(slab.num_classes()) {}
+
+        std::mutex mu;
+        SlabAllocator slab;
+        SlabLru lru;
+        std::unordered_map<uint64_t, SlabItem*> index;
+        uint64_t raw_bytes = 0, stored_bytes = 0;   // of the entries in index
+        uint64_t misses = 0, evictions = 0, compressed = 0, stored_raw = 0, bypassed = 0, too_large = 0;   // under mu
+        std::atomic<uint64_t> hits{0}, bad{0};       // counted after the unlocked decode
+        std::atomic<uint32_t> saving{1024};          // recent compression saving, 1/1024ths; racy by design
+        std::atomic<uint32_t> puts{0};               // bypass sampling
+    };
+
+    uint32_t min_saving_fixed() const { return uint32_t(opt_.min_saving * 1024); }
+
+    // A chunk of class cls, evicting within the class or moving a page over if
+    // needed. nullptr only if no class has a page to give, i.e. the budget is
+    // below one page.
+    char* allocate(Shard& s, int cls) {
+        for (;;) {
+            if (char* p = s.slab.allocate(cls)) return p;
+            if (SlabItem* victim = s.lru.tail(cls)) {
+                drop(s, victim);
+                s.slab.deallocate(cls, reinterpret_cast<char*>(victim));
+                ++s.evictions;
+                continue;
+            }
+            const int donor = s.slab.donor_class(cls);
+            if (donor < 0) return nullptr;
+            s.slab.move_page(donor, cls, [&](char* chunk) {
+                drop(s, reinterpret_cast<SlabItem*>(chunk));
+                ++s.evictions;
+            });
+        }
+    }
+
+    bool remove(Shard& s, uint64_t h) {
+        auto f = s.index.find(h);
+        if (f == s.index.end()) return false;
+        SlabItem* it = f->second;
+        drop(s, it);
+        s.slab.deallocate(it->cls, reinterpret_cast<char*>(it));
+        return true;
+    }
+
+    // Unlinks an entry and forgets it; its chunk is the caller's to free or reuse.
+    void drop(Shard& s, SlabItem* it) {
+        s.lru.unlink(it);
+        s.index.erase(it->hash);
+        s.raw_bytes -= raw_size(it);
+        s.stored_bytes -= sizeof(SlabItem) + it->size;
+    }
+
+    static uint64_t raw_size(const SlabItem* it) {
+        if (!(it->flags & kCompressed)) return it->size;
+        uint32_t n;
+        std::memcpy(&n, it->data(), 4);
+        return n;
+    }
+
+    std::optional<Value> miss(Shard& s) {
+        s.bad.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+
+    CompressedTierOptions opt_;
+    KeyCodec kc_;
+    ValueCodec vc_;
+    std::hash<Key> hasher_;
+    uint64_t budget_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
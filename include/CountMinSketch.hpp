@@ -30,6 +30,13 @@ public:
         return m == UINT32_MAX ? 0u : m;
     }
 
+    size_t width() const { return width_; }
+    size_t depth() const { return depth_; }
+
+    // Raw counters of one row, for snapshots.
+    const std::vector<uint32_t>& row(size_t i) const { return rows_[i]; }
+    std::vector<uint32_t>& row(size_t i) { return rows_[i]; }
+
     void decay_half() {
         for (auto& row : rows_)
             for (auto& c : row) c >>= 1;
@@ -0,0 +1,40 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Cheap timestamps for the optional instrumentation (stage timing, lock stats):
+// the TSC on x86, the virtual counter on AArch64, steady_clock nanoseconds
+// elsewhere. Values are in ticks; ticks_per_ns() converts when reporting.
+namespace cycle_clock {
+
+inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t v;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Counter frequency against steady_clock, measured once over ~10 ms on first use.
+inline double ticks_per_ns() {
+    static const double rate = [] {
+        const auto t0 = std::chrono::steady_clock::now();
+        const uint64_t c0 = ticks();
+        auto t1 = t0;
+        while (t1 - t0 < std::chrono::milliseconds(10)) t1 = std::chrono::steady_clock::now();
+        const uint64_t c1 = ticks();
+        const double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+        return ns > 0 ? double(c1 - c0) / ns : 1.0;
+    }();
+    return rate;
+}
+
+} // namespace cycle_clock
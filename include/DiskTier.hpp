@@ -0,0 +1,581 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Snapshot.hpp"
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define PCACHE_HAVE_IO_URING 1
+#endif
+
+struct DiskTierOptions {
+    size_t shards = 16;
+    size_t region_bytes = size_t(1) << 20;   // unit of writing and of reclaiming space
+    bool io_uring = true;                    // batched reads through io_uring where the kernel allows it
+    unsigned io_depth = 64;                  // io_uring queue entries per reading thread
+    size_t write_queue = 2;                  // sealed regions per shard held in memory awaiting their write
+};
+
+namespace disk_tier_detail {
+
+struct ReadRequest {
+    uint64_t offset;
+    uint32_t len;
+    char* out;
+    bool ok;
+};
+
+inline bool pread_full(int fd, char* out, size_t len, uint64_t offset) {
+#if defined(__unix__) || defined(__APPLE__)
+    while (len) {
+        const ssize_t n = ::pread(fd, out, len, off_t(offset));
+        if (n <= 0) return false;
+        out += n;
+        len -= size_t(n);
+        offset += uint64_t(n);
+    }
+    return true;
+#else
+    (void)fd, (void)out, (void)len, (void)offset;
+    return false;
+#endif
+}
+
+inline bool pwrite_full(int fd, const char* p, size_t len, uint64_t offset) {
+#if defined(__unix__) || defined(__APPLE__)
+    while (len) {
+        const ssize_t n = ::pwrite(fd, p, len, off_t(offset));
+        if (n <= 0) return false;
+        p += n;
+        len -= size_t(n);
+        offset += uint64_t(n);
+    }
+    return true;
+#else
+    (void)fd, (void)p, (void)len, (void)offset;
+    return false;
+#endif
+}
+
+#if defined(PCACHE_HAVE_IO_URING)
+// Minimal io_uring reader on the raw system calls (no liburing): one ring per
+// thread, submitting a batch of reads and waiting for all of them. ok() is
+// false where io_uring_setup is refused (old kernel, seccomp, container
+// policy); read() returns false if the ring fails, and requests it could not
+// complete are left with ok = false for the caller to retry with pread.
+class IoUringReader {
+public:
+    explicit IoUringReader(unsigned entries) {
+        io_uring_params p{};
+        fd_ = int(::syscall(__NR_io_uring_setup, entries, &p));
+        if (fd_ < 0) return;
+        sq_entries_ = p.sq_entries;
+        sq_bytes_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_bytes_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sq_bytes_ = cq_bytes_ = std::max(sq_bytes_, cq_bytes_);
+        sq_ = ::mmap(nullptr, sq_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        cq_ = single ? sq_
+                     : ::mmap(nullptr, cq_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                              IORING_OFF_CQ_RING);
+        sqes_bytes_ = p.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(nullptr, sqes_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                            IORING_OFF_SQES);
+        if (sqes != MAP_FAILED) sqes_ = static_cast<io_uring_sqe*>(sqes);
+        if (sq_ == MAP_FAILED || cq_ == MAP_FAILED || !sqes_) {
+            release();
+            return;
+        }
+        char* sq = static_cast<char*>(sq_);
+        char* cq = static_cast<char*>(cq_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+    }
+
+    ~IoUringReader() { release(); }
+
+    IoUringReader(const IoUringReader&) = delete;
+    IoUringReader& operator=(const IoUringReader&) = delete;
+
+    bool ok() const { return sqes_ != nullptr; }
+
+    // Reads every request it can through the ring; requests left with ok = false
+    // (errors, short reads, or ones the kernel would not take) are for pread.
+    // false if the ring failed and is no longer usable.
+    bool read(int fd, ReadRequest* reqs, size_t n) {
+        for (size_t first = 0; first < n; first += sq_entries_) {
+            const unsigned batch = unsigned(std::min<size_t>(sq_entries_, n - first));
+            const unsigned start = *sq_tail_;   // only this thread writes the tail
+            unsigned tail = start;
+            for (unsigned j = 0; j < batch; ++j, ++tail) {
+                const ReadRequest& r = reqs[first + j];
+                const unsigned idx = tail & sq_mask_;
+                io_uring_sqe& sqe = sqes_[idx];
+                std::memset(&sqe, 0, sizeof(sqe));
+                sqe.opcode = IORING_OP_READ;
+                sqe.fd = fd;
+                sqe.addr = reinterpret_cast<uint64_t>(r.out);
+                sqe.len = r.len;
+                sqe.off = r.offset;
+                sqe.user_data = first + j;
+                sq_array_[idx] = idx;
+            }
+            __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+            // The kernel's SQ head tells how many SQEs it has taken, whatever
+            // io_uring_enter returned (EINTR, a short submission). A call that
+            // submits waits only for reads already in flight before it, which
+            // always complete; the loop submits the rest and waits again. If
+            // the kernel takes none twice in a row, they are withdrawn from the
+            // ring and left to pread.
+            unsigned end = batch, done = 0, stalls = 0;
+            for (;;) {
+                const unsigned submitted = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) - start;
+                if (submitted < end && stalls >= 2) {
+                    __atomic_store_n(sq_tail_, start + submitted, __ATOMIC_RELEASE);   // no SQPOLL: safe to rewind
+                    end = submitted;
+                }
+                if (done == end) break;
+                const unsigned wait = submitted < end ? submitted - done : end - done;
+                const long rc = ::syscall(__NR_io_uring_enter, fd_, end - submitted, wait,
+                                          IORING_ENTER_GETEVENTS, nullptr, 0);
+                if (rc < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                    release();   // submissions may be stuck in the ring: stop using it
+                    return false;
+                }
+                const bool interrupted = rc < 0 && errno == EINTR;
+                if (submitted < end && !interrupted)
+                    stalls = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) - start == submitted ? stalls + 1 : 0;
+                unsigned head = *cq_head_;
+                const unsigned ctail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+                for (; head != ctail; ++head, ++done) {
+                    const io_uring_cqe& c = cqes_[head & cq_mask_];
+                    ReadRequest& r = reqs[c.user_data];
+                    r.ok = c.res == int(r.len);   // short reads and errors go to pread
+                }
+                __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+            }
+        }
+        return true;
+    }
+
+private:
+    void release() {
+        if (sqes_) ::munmap(sqes_, sqes_bytes_);
+        if (cq_ && cq_ != MAP_FAILED && cq_ != sq_) ::munmap(cq_, cq_bytes_);
+        if (sq_ && sq_ != MAP_FAILED) ::munmap(sq_, sq_bytes_);
+        if (fd_ >= 0) ::close(fd_);
+        sq_ = cq_ = nullptr;
+        sqes_ = nullptr;
+        fd_ = -1;
+    }
+
+    int fd_ = -1;
+    unsigned sq_entries_ = 0;
+    size_t sq_bytes_ = 0, cq_bytes_ = 0, sqes_bytes_ = 0;
+    void* sq_ = nullptr;
+    void* cq_ = nullptr;
+    io_uring_sqe* sqes_ = nullptr;
+    unsigned *sq_head_ = nullptr, *sq_tail_ = nullptr, *sq_array_ = nullptr, *cq_head_ = nullptr, *cq_tail_ = nullptr;
+    unsigned sq_mask_ = 0, cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+};
+#endif
+
+// Reads every request, through this thread's io_uring if allowed and available,
+// with pread for whatever it does not complete. Returns true if io_uring was used.
+inline bool read_all(int fd, ReadRequest* reqs, size_t n, bool allow_io_uring, unsigned depth) {
+    bool used = false;
+#if defined(PCACHE_HAVE_IO_URING)
+    if (allow_io_uring && n > 1) {
+        static thread_local IoUringReader ring(depth);   // first caller's depth wins
+        used = ring.ok() && ring.read(fd, reqs, n);
+    }
+#else
+    (void)allow_io_uring, (void)depth;
+#endif
+    for (size_t i = 0; i < n; ++i)
+        if (!used || !reqs[i].ok) reqs[i].ok = pread_full(fd, reqs[i].out, reqs[i].len, reqs[i].offset);
+    return used;
+}
+
+}  // namespace disk_tier_detail
+
+// Second cache tier on local disk for entries the DRAM cache lets go (see
+// TieredCache.hpp). One scratch file, split evenly between shards; each shard
+// writes its part as a log of fixed-size regions, FIFO:
+//
+//   - put() appends the record { u32 body length, u32 region generation,
+//     u64 checksum, key, value } to the shard's open region, an in-memory
+//     buffer. A full buffer is sealed: it is queued for the writer thread,
+//     which writes it with one pwrite, and the oldest region is reclaimed to
+//     become the next open one: its entries are dropped. put() never writes
+//     itself; it waits only when write_queue sealed regions of its shard are
+//     already queued (counted in Stats::write_stalls).
+//   - The index is compact: key hash -> { region, offset, length, generation },
+//     16 bytes plus the hash table node. Keys and values live only on disk,
+//     or in memory while their region is open or its write is pending.
+//   - get() looks up the index under the shard lock and reads the record
+//     without it. The record's generation, checksum and key are checked, so a
+//     region reclaimed and rewritten meanwhile reads as a miss.
+//   - get_batch() of more than one disk-resident key issues its reads at once
+//     through io_uring and waits for them together; a single get() and hosts
+//     without io_uring use pread.
+//
+// Erasing or overwriting a key only updates the index; the space is reclaimed
+// with its region. The file is unlinked as soon as it is opened, so nothing
+// stays behind; the tier starts empty. Records larger than a region are not
+// stored. POSIX only; the constructor throws std::runtime_error elsewhere.
+template <typename Key, typename Value, typename KeyCodec = SnapshotCodec<Key>,
+          typename ValueCodec = SnapshotCodec<Value>>
+class DiskTier {
+public:
+    struct Stats {
+        uint64_t entries = 0;
+        uint64_t capacity_bytes = 0;
+        uint64_t records_written = 0, bytes_written = 0;
+        uint64_t hits = 0, misses = 0;
+        uint64_t dropped = 0;       // entries lost to region reclaim
+        uint64_t bad_reads = 0;     // failed reads and records that did not verify
+        uint64_t too_large = 0;     // puts larger than a region
+        uint64_t write_stalls = 0;  // seals that waited for the writer thread
+        uint64_t io_uring_batches = 0;
+    };
+
+    DiskTier(const std::string& path, uint64_t capacity_bytes, const DiskTierOptions& opt = DiskTierOptions{},
+             const KeyCodec& kc = KeyCodec{}, const ValueCodec& vc = ValueCodec{})
+        : opt_(opt), kc_(kc), vc_(vc), shards_(opt.shards) {
+        if (opt.shards == 0) throw std::invalid_argument("shards must be > 0");
+        if (opt.region_bytes < kHeader || opt.region_bytes > (uint64_t(1) << 31))
+            throw std::invalid_argument("region_bytes out of range");
+        if (opt.write_queue == 0) throw std::invalid_argument("write_queue must be > 0");
+        regions_ = size_t(capacity_bytes / opt.shards / opt.region_bytes);
+        if (regions_ < 2) throw std::invalid_argument("capacity_bytes must hold 2 regions per shard");
+        capacity_bytes_ = uint64_t(regions_) * opt.region_bytes * opt.shards;
+#if defined(__unix__) || defined(__APPLE__)
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (fd_ < 0) throw std::runtime_error("disk tier: cannot open " + path);
+        ::unlink(path.c_str());
+        if (::ftruncate(fd_, off_t(capacity_bytes_)) != 0) {
+            ::close(fd_);
+            throw std::runtime_error("disk tier: cannot size " + path);
+        }
+#else
+        throw std::runtime_error("disk tier: needs POSIX file I/O");
+#endif
+        for (auto& s : shards_) {
+            s.region_keys.resize(regions_);
+            s.region_gen.assign(regions_, 0);
+            s.writing.resize(regions_);
+            s.buf.reserve(opt.region_bytes);
+        }
+        writer_ = std::thread([this] { run(); });
+    }
+
+    ~DiskTier() {
+        {
+            std::scoped_lock l(q_mu_);
+            stop_ = true;
+        }
+        q_cv_.notify_all();
+        if (writer_.joinable()) writer_.join();
+#if defined(__unix__) || defined(__APPLE__)
+        if (fd_ >= 0) ::close(fd_);
+#endif
+    }
+
+    DiskTier(const DiskTier&) = delete;
+    DiskTier& operator=(const DiskTier&) = delete;
+
+    void put(const Key& key, const Value& value) {
+        std::string rec(kHeader, '\0');
+        kc_.encode(rec, key);
+        vc_.encode(rec, value);
+        const uint64_t h = hasher_(key);
+        Shard& s = shards_[h % shards_.size()];
+        std::scoped_lock l(s.mu);
+        if (rec.size() > opt_.region_bytes) {
+            ++s.too_large;
+            s.index.erase(h);   // the older copy must not be served
+            return;
+        }
+        if (s.buf.size() + rec.size() > opt_.region_bytes) seal(s, h % shards_.size());
+        const uint32_t body = uint32_t(rec.size() - kHeader), gen = s.region_gen[s.active];
+        const uint64_t sum = snapshot_detail::checksum(rec.data() + kHeader, body);
+        std::memcpy(&rec[0], &body, 4);
+        std::memcpy(&rec[4], &gen, 4);
+        std::memcpy(&rec[8], &sum, 8);
+        s.index[h] = Loc{uint32_t(s.active), uint32_t(s.buf.size()), uint32_t(rec.size()), gen};
+        s.region_keys[s.active].push_back(h);
+        s.buf += rec;
+        ++s.records_written;
+    }
+
+    // One read at most, so pread: the ring is not worth it for a single request.
+    std::optional<Value> get(const Key& key) { return std::move(get_batch(&key, 1)[0]); }
+
+    // Values of keys[0..n), reading all disk-resident ones in one batch (io_uring
+    // when there are two or more).
+    std::vector<std::optional<Value>> get_batch(const Key* keys, size_t n) {
+        std::vector<std::optional<Value>> out(n);
+        std::vector<Pending> pending;
+        std::string copy;
+        for (size_t i = 0; i < n; ++i) {
+            const uint64_t h = hasher_(keys[i]);
+            const size_t si = h % shards_.size();
+            Shard& s = shards_[si];
+            std::unique_lock l(s.mu);
+            auto it = s.index.find(h);
+            if (it == s.index.end()) {
+                ++s.misses;
+                continue;
+            }
+            const Loc loc = it->second;
+            const std::string* mem = nullptr;
+            if (loc.gen == s.region_gen[loc.region]) {
+                if (loc.region == s.active) mem = &s.buf;                             // still open
+                else if (s.writing[loc.region]) mem = s.writing[loc.region].get();   // write pending
+            }
+            if (mem) {
+                copy.assign(*mem, loc.offset, loc.len);
+                l.unlock();
+                out[i] = verify(copy.data(), loc, keys[i], s);
+                continue;
+            }
+            pending.push_back(Pending{i, si, loc});
+        }
+        if (pending.empty()) return out;
+        std::vector<char> data;
+        std::vector<disk_tier_detail::ReadRequest> reqs(pending.size());
+        size_t total = 0;
+        for (const auto& p : pending) total += p.loc.len;
+        data.resize(total);
+        total = 0;
+        for (size_t j = 0; j < pending.size(); ++j) {
+            const Loc& loc = pending[j].loc;
+            reqs[j] = {region_offset(pending[j].shard, loc.region) + loc.offset, loc.len, data.data() + total, false};
+            total += loc.len;
+        }
+        const bool ring = disk_tier_detail::read_all(fd_, reqs.data(), reqs.size(), opt_.io_uring, opt_.io_depth);
+        if (ring) io_uring_batches_.fetch_add(1, std::memory_order_relaxed);
+        for (size_t j = 0; j < pending.size(); ++j) {
+            Shard& s = shards_[pending[j].shard];
+            if (!reqs[j].ok) {
+                bad_read(s);
+                continue;
+            }
+            out[pending[j].index] = verify(reqs[j].out, pending[j].loc, keys[pending[j].index], s);
+        }
+        return out;
+    }
+
+    std::vector<std::optional<Value>> get_batch(const std::vector<Key>& keys) {
+        return get_batch(keys.data(), keys.size());
+    }
+
+    bool erase(const Key& key) {
+        const uint64_t h = hasher_(key);
+        Shard& s = shards_[h % shards_.size()];
+        std::scoped_lock l(s.mu);
+        return s.index.erase(h) != 0;
+    }
+
+    size_t size() {
+        size_t n = 0;
+        for (auto& s : shards_) {
+            std::scoped_lock l(s.mu);
+            n += s.index.size();
+        }
+        return n;
+    }
+
+    uint64_t capacity_bytes() const { return capacity_bytes_; }
+
+    Stats stats() {
+        Stats st;
+        st.capacity_bytes = capacity_bytes_;
+        for (auto& s : shards_) {
+            std::scoped_lock l(s.mu);
+            st.entries += s.index.size();
+            st.records_written += s.records_written;
+            st.bytes_written += s.bytes_written;
+            st.misses += s.misses;
+            st.dropped += s.dropped;
+            st.too_large += s.too_large;
+            st.write_stalls += s.write_stalls;
+            st.hits += s.hits.load(std::memory_order_relaxed);
+            st.bad_reads += s.bad_reads.load(std::memory_order_relaxed);
+        }
+        st.misses += st.bad_reads;
+        st.io_uring_batches = io_uring_batches_.load(std::memory_order_relaxed);
+        return st;
+    }
+
+private:
+    static constexpr size_t kHeader = 16;   // u32 body length, u32 generation, u64 checksum
+
+    struct Loc {
+        uint32_t region, offset, len, gen;
+    };
+
+    struct Pending {
+        size_t index, shard;
+        Loc loc;
+    };
+
+    struct Write {   // a sealed region queued for the writer thread
+        size_t shard, region;
+        uint32_t gen;
+        std::shared_ptr<const std::string> data;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mu;
+        std::unordered_map<uint64_t, Loc> index;          // key hash -> newest record
+        std::vector<std::vector<uint64_t>> region_keys;   // hashes written to each region
+        std::vector<uint32_t> region_gen;                 // bumped each time a region is reclaimed
+        std::string buf;                                  // the open region
+        std::vector<std::shared_ptr<const std::string>> writing;   // sealed regions whose write is pending
+        size_t active = 0;
+        size_t queued = 0;                                // writes not yet done, under q_mu_
+        uint64_t records_written = 0, bytes_written = 0, misses = 0, dropped = 0, too_large = 0;   // under mu
+        uint64_t write_stalls = 0;
+        std::atomic<uint64_t> hits{0}, bad_reads{0};      // counted after the unlocked read
+    };
+
+    uint64_t region_offset(size_t shard, size_t region) const {
+        return (uint64_t(shard) * regions_ + region) * opt_.region_bytes;
+    }
+
+    // Queues the open region for the writer, then reclaims the oldest one as the
+    // next open region. The sealed buffer serves reads until its write is done.
+    // Waits, with the shard lock held, only if the shard's queue is full; the
+    // writer never takes a shard lock before making room.
+    void seal(Shard& s, size_t shard) {
+        auto data = std::make_shared<const std::string>(std::move(s.buf));
+        s.buf = std::string();
+        s.buf.reserve(opt_.region_bytes);
+        s.writing[s.active] = data;
+        {
+            std::unique_lock l(q_mu_);
+            if (s.queued >= opt_.write_queue) {
+                ++s.write_stalls;
+                done_cv_.wait(l, [&] { return s.queued < opt_.write_queue; });
+            }
+            ++s.queued;
+            queue_.push_back(Write{shard, s.active, s.region_gen[s.active], std::move(data)});
+        }
+        q_cv_.notify_one();
+        s.active = (s.active + 1) % regions_;
+        drop_region(s, s.active);
+        s.writing[s.active].reset();   // an older write of it still queued lands before any newer one
+        ++s.region_gen[s.active];
+    }
+
+    // Writer thread: writes sealed regions in FIFO order, so a region's writes
+    // reach the file in the order they were sealed. Drains the queue on stop.
+    void run() {
+        std::unique_lock l(q_mu_);
+        for (;;) {
+            q_cv_.wait(l, [&] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            Write w = std::move(queue_.front());
+            queue_.pop_front();
+            l.unlock();
+            const bool ok =
+                disk_tier_detail::pwrite_full(fd_, w.data->data(), w.data->size(), region_offset(w.shard, w.region));
+            Shard& s = shards_[w.shard];
+            {
+                std::scoped_lock ql(q_mu_);
+                --s.queued;
+            }
+            done_cv_.notify_all();
+            {
+                std::scoped_lock sl(s.mu);
+                if (ok) s.bytes_written += w.data->size();
+                else if (s.region_gen[w.region] == w.gen) drop_region(s, w.region);   // nothing of it reached the file
+                if (s.writing[w.region] == w.data) s.writing[w.region].reset();
+            }
+            l.lock();
+        }
+    }
+
+    void drop_region(Shard& s, size_t region) {
+        const uint32_t gen = s.region_gen[region];
+        for (uint64_t h : s.region_keys[region]) {
+            auto it = s.index.find(h);
+            if (it != s.index.end() && it->second.region == region && it->second.gen == gen) {
+                s.index.erase(it);
+                ++s.dropped;
+            }
+        }
+        s.region_keys[region].clear();
+    }
+
+    std::optional<Value> verify(const char* p, const Loc& loc, const Key& key, Shard& s) {
+        uint32_t body, gen;
+        uint64_t sum;
+        std::memcpy(&body, p, 4);
+        std::memcpy(&gen, p + 4, 4);
+        std::memcpy(&sum, p + 8, 8);
+        if (body + kHeader != loc.len || gen != loc.gen || sum != snapshot_detail::checksum(p + kHeader, body)) {
+            bad_read(s);
+            return std::nullopt;
+        }
+        try {
+            SnapshotReader in(p + kHeader, body);
+            if (!(kc_.decode(in) == key)) {   // another key with the same hash
+                bad_read(s);
+                return std::nullopt;
+            }
+            std::optional<Value> v(vc_.decode(in));
+            s.hits.fetch_add(1, std::memory_order_relaxed);
+            return v;
+        } catch (const std::runtime_error&) {
+            bad_read(s);
+            return std::nullopt;
+        }
+    }
+
+    static void bad_read(Shard& s) { s.bad_reads.fetch_add(1, std::memory_order_relaxed); }
+
+    DiskTierOptions opt_;
+    KeyCodec kc_;
+    ValueCodec vc_;
+    std::hash<Key> hasher_;
+    size_t regions_ = 0;   // per shard
+    uint64_t capacity_bytes_ = 0;
+    int fd_ = -1;
+    std::vector<Shard> shards_;
+    std::atomic<uint64_t> io_uring_batches_{0};
+    std::mutex q_mu_;                         // guards queue_, stop_ and Shard::queued
+    std::condition_variable q_cv_, done_cv_;  // work for the writer; a write done
+    std::deque<Write> queue_;
+    bool stop_ = false;
+    std::thread writer_;
+};
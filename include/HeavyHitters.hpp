@@ -0,0 +1,198 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "CacheCounters.hpp"
+
+// A frequently accessed key as reported by a sharded cache's stats().
+template <typename Key>
+struct HotKey {
+    Key key;
+    uint64_t count = 0;   // estimated gets; overestimates the true count by at most `error`
+    uint64_t error = 0;
+    size_t shard = 0;
+};
+
+// Space-Saving (Metwally, Agrawal, El Abbadi) over a fixed number of counters.
+// The counters sit in a min-heap; an untracked key takes over the smallest one
+// and inherits its count as error. Any key seen more than total/capacity times
+// is tracked, and its count overestimates by at most `error`. Counts are halved
+// every `halve_after` updates so the list follows the current hot set rather
+// than the all-time one. Memory is capacity keys plus a small index.
+template <typename Key, typename Hash = std::hash<Key>>
+class SpaceSaving {
+public:
+    struct Entry {
+        Key key;
+        uint64_t count, error;
+    };
+
+    explicit SpaceSaving(size_t capacity, uint64_t halve_after = uint64_t(1) << 14)
+        : capacity_(capacity), halve_after_(halve_after) {
+        if (capacity == 0) throw std::invalid_argument("capacity must be > 0");
+        heap_.reserve(capacity);
+        index_.reserve(capacity);
+    }
+
+    // Heap slots point into index_, whose elements stay put until erased.
+    SpaceSaving(const SpaceSaving&) = delete;
+    SpaceSaving& operator=(const SpaceSaving&) = delete;
+    SpaceSaving(SpaceSaving&&) = default;
+    SpaceSaving& operator=(SpaceSaving&&) = default;
+
+    void add(const Key& key, uint64_t weight = 1) {
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            heap_[it->second].count += weight;
+            sift_down(it->second);
+        } else if (heap_.size() < capacity_) {
+            auto ins = index_.emplace(key, heap_.size()).first;
+            heap_.push_back(Slot{weight, 0, &*ins});
+            sift_up(heap_.size() - 1);
+        } else {
+            Slot& min = heap_[0];
+            index_.erase(min.entry->first);
+            min.entry = &*index_.emplace(key, 0).first;
+            min.error = min.count;
+            min.count += weight;
+            sift_down(0);
+        }
+        if (++updates_ >= halve_after_) halve();
+    }
+
+    // Tracked keys by descending count, at most k of them.
+    std::vector<Entry> top(size_t k) const {
+        std::vector<Entry> out;
+        out.reserve(heap_.size());
+        for (const auto& s : heap_) out.push_back(Entry{s.entry->first, s.count, s.error});
+        k = std::min(k, out.size());
+        std::partial_sort(out.begin(), out.begin() + k, out.end(),
+                          [](const Entry& a, const Entry& b) { return a.count > b.count; });
+        out.erase(out.begin() + k, out.end());
+        return out;
+    }
+
+    // Halving is monotone, so the heap order survives it.
+    void halve() {
+        for (auto& s : heap_) {
+            s.count >>= 1;
+            s.error >>= 1;
+        }
+        updates_ = 0;
+    }
+
+    size_t size() const { return heap_.size(); }
+
+private:
+    using Index = std::unordered_map<Key, size_t, Hash>;   // key -> heap position
+
+    struct Slot {
+        uint64_t count, error;
+        typename Index::value_type* entry;
+    };
+
+    void swap_slots(size_t a, size_t b) {
+        std::swap(heap_[a], heap_[b]);
+        heap_[a].entry->second = a;
+        heap_[b].entry->second = b;
+    }
+
+    void sift_up(size_t i) {
+        while (i > 0) {
+            const size_t p = (i - 1) / 2;
+            if (heap_[p].count <= heap_[i].count) break;
+            swap_slots(i, p);
+            i = p;
+        }
+    }
+
+    void sift_down(size_t i) {
+        for (;;) {
+            size_t m = i;
+            const size_t l = 2 * i + 1, r = l + 1;
+            if (l < heap_.size() && heap_[l].count < heap_[m].count) m = l;
+            if (r < heap_.size() && heap_[r].count < heap_[m].count) m = r;
+            if (m == i) return;
+            swap_slots(i, m);
+            i = m;
+        }
+    }
+
+    size_t capacity_;
+    uint64_t halve_after_;
+    uint64_t updates_ = 0;
+    std::vector<Slot> heap_;
+    Index index_;
+};
+
+#ifndef PCACHE_HOT_KEYS_PER_SHARD
+#define PCACHE_HOT_KEYS_PER_SHARD 16
+#endif
+#ifndef PCACHE_HOT_SAMPLE_SHIFT
+#define PCACHE_HOT_SAMPLE_SHIFT 4
+#endif
+
+// Hot-key tracking for the sharded caches: one SpaceSaving of
+// PCACHE_HOT_KEYS_PER_SHARD keys per shard, fed with a random one in
+// 2^PCACHE_HOT_SAMPLE_SHIFT gets (random, so a periodic access pattern cannot
+// alias with the sampling). An unsampled get costs a xorshift step and a branch.
+// Reported counts are scaled back up by the sampling rate. Shard i's tracker is
+// guarded by the cache's lock for shard i. Compiled out with PCACHE_DISABLE_STATS.
+template <typename Key>
+class ShardedHotKeys {
+public:
+    explicit ShardedHotKeys(size_t shards) {
+        if constexpr (kStatsEnabled) {
+            shards_.reserve(shards);
+            for (size_t i = 0; i < shards; ++i) shards_.emplace_back(i);
+        }
+    }
+
+    void on_get(size_t shard, const Key& key) {
+        if constexpr (kStatsEnabled) {
+            Shard& s = shards_[shard];
+            s.rng ^= s.rng << 13;
+            s.rng ^= s.rng >> 7;
+            s.rng ^= s.rng << 17;
+            if ((s.rng & ((uint64_t(1) << PCACHE_HOT_SAMPLE_SHIFT) - 1)) == 0) s.tracker.add(key);
+        } else {
+            (void)shard;
+            (void)key;
+        }
+    }
+
+    // Appends shard's tracked keys to out.
+    void collect(size_t shard, std::vector<HotKey<Key>>& out) const {
+        if constexpr (kStatsEnabled) {
+            for (auto& e : shards_[shard].tracker.top(PCACHE_HOT_KEYS_PER_SHARD))
+                out.push_back(HotKey<Key>{std::move(e.key), e.count << PCACHE_HOT_SAMPLE_SHIFT,
+                                          e.error << PCACHE_HOT_SAMPLE_SHIFT, shard});
+        } else {
+            (void)shard;
+            (void)out;
+        }
+    }
+
+    // Keeps the k hottest of keys collected from all shards, hottest first.
+    static void rank(std::vector<HotKey<Key>>& keys, size_t k) {
+        k = std::min(k, keys.size());
+        std::partial_sort(keys.begin(), keys.begin() + k, keys.end(),
+                          [](const HotKey<Key>& a, const HotKey<Key>& b) { return a.count > b.count; });
+        keys.erase(keys.begin() + k, keys.end());
+    }
+
+private:
+    struct alignas(64) Shard {
+        // xorshift needs a non-zero seed; distinct per shard
+        explicit Shard(size_t i) : rng((i + 1) * 0x9e3779b97f4a7c15ULL), tracker(PCACHE_HOT_KEYS_PER_SHARD) {}
+
+        uint64_t rng;
+        SpaceSaving<Key> tracker;
+    };
+
+    std::vector<Shard> shards_;
+};
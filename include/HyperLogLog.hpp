@@ -0,0 +1,150 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// HyperLogLog distinct-count sketch (Flajolet et al., with linear counting for
+// small counts) over 2^precision one-byte registers. Relative standard error is
+// about 1.04 / sqrt(2^precision): 3.3% at the default precision of 10 (1 KB).
+// Sketches of the same precision merge by register-wise max into the sketch of
+// the union. Callers pass an already mixed 64-bit key hash (see mix64 in KeyHash.hpp).
+class HyperLogLog {
+public:
+    explicit HyperLogLog(unsigned precision = 10) : p_(precision), regs_(size_t(1) << precision, 0) {
+        if (precision < 4 || precision > 18) throw std::invalid_argument("precision must be in [4, 18]");
+    }
+
+    void add(uint64_t h) {
+        const size_t idx = size_t(h >> (64 - p_));
+        const uint64_t rest = h << p_;
+        const uint8_t rank = rest ? uint8_t(leading_zeros(rest) + 1) : uint8_t(64 - p_ + 1);
+        if (rank > regs_[idx]) regs_[idx] = rank;
+    }
+
+    void merge(const HyperLogLog& o) {
+        if (o.p_ != p_) throw std::invalid_argument("HyperLogLog precision mismatch");
+        for (size_t i = 0; i < regs_.size(); ++i) regs_[i] = std::max(regs_[i], o.regs_[i]);
+    }
+
+    double estimate() const {
+        const double m = double(regs_.size());
+        double sum = 0.0;
+        size_t zeros = 0;
+        for (uint8_t r : regs_) {
+            sum += std::ldexp(1.0, -int(r));
+            zeros += r == 0;
+        }
+        const double alpha = 0.7213 / (1.0 + 1.079 / m);
+        const double e = alpha * m * m / sum;
+        if (e <= 2.5 * m && zeros) return m * std::log(m / double(zeros));
+        return e;   // 64-bit hashes: no large-range correction needed
+    }
+
+    void clear() { std::fill(regs_.begin(), regs_.end(), uint8_t(0)); }
+
+    unsigned precision() const { return p_; }
+
+private:
+    static unsigned leading_zeros(uint64_t x) {   // x != 0
+#if defined(__GNUC__) || defined(__clang__)
+        return unsigned(__builtin_clzll(x));
+#else
+        unsigned n = 0;
+        while (!(x & (uint64_t(1) << 63))) {
+            x <<= 1;
+            ++n;
+        }
+        return n;
+#endif
+    }
+
+    unsigned p_;
+    std::vector<uint8_t> regs_;
+};
+
+// A ring of HyperLogLogs, one per time window. add() goes to the current
+// window; rotate() starts a new one and drops the oldest, so the retained
+// windows always cover the last `windows` rotation periods. The owner decides
+// what a period is, usually by calling rotate() on a timer.
+class WindowedHyperLogLog {
+public:
+    explicit WindowedHyperLogLog(size_t windows = 4, unsigned precision = 10)
+        : ring_(windows, HyperLogLog(precision)) {
+        if (windows == 0) throw std::invalid_argument("windows must be > 0");
+    }
+
+    void add(uint64_t h) { ring_[cur_].add(h); }
+
+    void rotate() {
+        cur_ = (cur_ + 1) % ring_.size();
+        ring_[cur_].clear();
+        filled_ = std::min(filled_ + 1, ring_.size());
+    }
+
+    const HyperLogLog& current() const { return ring_[cur_]; }
+
+    // Union of the retained windows.
+    HyperLogLog retained() const {
+        HyperLogLog u = ring_[cur_];
+        for (size_t w = 0; w < ring_.size(); ++w)
+            if (w != cur_) u.merge(ring_[w]);
+        return u;
+    }
+
+    // Windows holding data: 1 until the first rotate(), then up to the ring size.
+    size_t windows() const { return filled_; }
+
+private:
+    std::vector<HyperLogLog> ring_;
+    size_t cur_ = 0;
+    size_t filled_ = 1;
+};
+
+#ifndef PCACHE_HLL_PRECISION
+#define PCACHE_HLL_PRECISION 10
+#endif
+#ifndef PCACHE_HLL_WINDOWS
+#define PCACHE_HLL_WINDOWS 4
+#endif
+
+// Distinct keys read by a sharded cache, with sizing suggestions derived from them.
+struct CardinalityEstimate {
+    double window = 0.0;            // distinct keys in the current window
+    double retained = 0.0;          // distinct keys over the retained windows: the working set
+    size_t windows = 0;             // windows covered by `retained`
+    std::vector<double> shards;     // per shard, over the retained windows
+    // Capacity that holds the whole working set. An upper bound: past it, extra
+    // capacity cannot raise the hit rate over these windows. The shadow caches
+    // of ShardedWTinyLFU show what smaller capacities achieve.
+    size_t suggested_capacity = 0;
+    // Per-shard TinyLFU sketch width: one counter per distinct key a shard sees in
+    // a window, and no fewer than its entries, rounded up to a power of two. This
+    // assumes the sketch is decayed about once per window.
+    size_t suggested_cms_width = 0;
+};
+
+// Summarizes per-shard windowed sketches (copied under the shard locks).
+inline CardinalityEstimate estimate_cardinality(const std::vector<WindowedHyperLogLog>& shards, size_t capacity) {
+    CardinalityEstimate est;
+    if (shards.empty()) return est;
+    HyperLogLog window(shards[0].current().precision()), retained(window.precision());
+    double widest = 0.0;
+    est.windows = shards[0].windows();
+    for (const auto& s : shards) {
+        const HyperLogLog r = s.retained();
+        window.merge(s.current());
+        retained.merge(r);
+        est.shards.push_back(r.estimate());
+        widest = std::max(widest, s.current().estimate());
+    }
+    est.window = window.estimate();
+    est.retained = retained.estimate();
+    est.suggested_capacity = size_t(std::ceil(est.retained));
+    const double per_shard_entries = double(capacity) / double(shards.size());
+    size_t w = 16;
+    while (double(w) < std::max(widest, per_shard_entries) && w < (size_t(1) << 30)) w <<= 1;
+    est.suggested_cms_width = w;
+    return est;
+}
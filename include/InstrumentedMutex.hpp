@@ -0,0 +1,130 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "CycleClock.hpp"
+#include "LogHistogram.hpp"
+#include "Probes.hpp"
+
+// Contention statistics for one shard lock.
+struct LockStats {
+    uint64_t acquisitions = 0;
+    uint64_t contended = 0;     // acquisitions whose try_lock failed and had to wait
+    LogHistogram wait_ticks;    // wait of contended acquisitions only (uncontended waits are ~0)
+    LogHistogram hold_ticks;    // sampled: one acquisition in 2^PCACHE_LOCK_SAMPLE_SHIFT
+    double ticks_per_ns = 1.0;
+
+    double contention_rate() const { return acquisitions ? double(contended) / double(acquisitions) : 0.0; }
+};
+
+#ifndef PCACHE_LOCK_SAMPLE_SHIFT
+#define PCACHE_LOCK_SAMPLE_SHIFT 4
+#endif
+
+// std::mutex that records how long callers wait for it and how long they hold it.
+// lock() tries try_lock first, so the uncontended path adds one counter update;
+// only a failed try_lock reads the clock around the blocking lock(). Hold time is
+// sampled. All statistics are updated while the mutex is held, so they need no
+// synchronization of their own. About 16 KB per mutex for the two histograms.
+class InstrumentedMutex {
+public:
+    void lock() {
+        if (!m_.try_lock()) {
+            const uint64_t t0 = cycle_clock::ticks();
+            m_.lock();
+            const uint64_t waited = cycle_clock::ticks() - t0;
+            ++stats_.contended;
+            stats_.wait_ticks.record(waited);
+            PCACHE_PROBE2(lock_wait, this, waited);
+        }
+        on_acquired();
+    }
+
+    bool try_lock() {
+        if (!m_.try_lock()) return false;
+        on_acquired();
+        return true;
+    }
+
+    void unlock() {
+        if (hold_start_) {
+            stats_.hold_ticks.record(cycle_clock::ticks() - hold_start_);
+            hold_start_ = 0;
+        }
+        m_.unlock();
+    }
+
+    // Copy of the statistics; takes the mutex without counting the acquisition.
+    LockStats stats() {
+        std::scoped_lock l(m_);
+        LockStats s = stats_;
+        s.ticks_per_ns = cycle_clock::ticks_per_ns();
+        return s;
+    }
+
+    void reset_stats() {
+        std::scoped_lock l(m_);
+        stats_ = LockStats{};
+    }
+
+private:
+    void on_acquired() {
+        if ((++stats_.acquisitions & ((uint64_t(1) << PCACHE_LOCK_SAMPLE_SHIFT) - 1)) == 0)
+            hold_start_ = cycle_clock::ticks();
+    }
+
+    std::mutex m_;
+    LockStats stats_;           // guarded by m_
+    uint64_t hold_start_ = 0;   // non-zero while a sampled hold is being timed
+};
+
+// std::mutex plus the lock_wait probe (Probes.hpp): a failed try_lock times the
+// blocking lock() and reports it. Nothing else is recorded.
+class ProbedMutex {
+public:
+    void lock() {
+        if (m_.try_lock()) return;
+        [[maybe_unused]] const uint64_t t0 = cycle_clock::ticks();
+        m_.lock();
+        PCACHE_PROBE2(lock_wait, this, cycle_clock::ticks() - t0);
+    }
+    bool try_lock() { return m_.try_lock(); }
+    void unlock() { m_.unlock(); }
+
+private:
+    std::mutex m_;
+};
+
+// Mutex type of the shard locks in ShardedLRU, ShardedWTinyLFU and
+// PredictiveShardedCache. Building with PCACHE_LOCK_STATS (CMake option of the
+// same name) switches them to InstrumentedMutex and fills their lock_stats();
+// PCACHE_ENABLE_SDT alone switches them to ProbedMutex.
+#if defined(PCACHE_LOCK_STATS)
+using ShardMutex = InstrumentedMutex;
+#elif defined(PCACHE_ENABLE_SDT)
+using ShardMutex = ProbedMutex;
+#else
+using ShardMutex = std::mutex;
+#endif
+
+// Per-shard lock statistics of a sharded cache; empty unless built with PCACHE_LOCK_STATS.
+template <typename Mutexes>
+std::vector<LockStats> collect_lock_stats(Mutexes& locks) {
+    std::vector<LockStats> out;
+#if defined(PCACHE_LOCK_STATS)
+    out.reserve(locks.size());
+    for (auto& m : locks) out.push_back(m.stats());
+#else
+    (void)locks;
+#endif
+    return out;
+}
+
+template <typename Mutexes>
+void clear_lock_stats(Mutexes& locks) {
+#if defined(PCACHE_LOCK_STATS)
+    for (auto& m : locks) m.reset_stats();
+#else
+    (void)locks;
+#endif
+}
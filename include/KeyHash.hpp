@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+
+// Finalizer from SplitMix64. std::hash is the identity for integral keys on the
+// common standard libraries, so anything that samples or buckets by hash bits
+// (shadow caches, sketches) should pass the raw hash through this first.
+inline uint64_t mix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
@@ -3,6 +3,8 @@
 #include <unordered_map>
 #include <optional>
 #include <utility>
+#include <functional>
+#include "Probes.hpp"
 
 template <typename Key, typename Value>
 class LRUCache {
@@ -19,6 +21,13 @@ class LRUCache {
         }
     
         void put(const Key& key, const Value& value){
+            put(key, value, [](Key&, Value&) {});
+        }
+
+        // put() that hands the evicted entry, if any, to on_evict(Key&, Value&)
+        // just before it is dropped.
+        template <typename OnEvict>
+        void put(const Key& key, const Value& value, OnEvict&& on_evict){
             auto it = map_.find(key);
             if (it != map_.end()){
                 it->second->second = value;
@@ -28,7 +37,9 @@ class LRUCache {
             items_.emplace_front(key, value);
             map_[key] = items_.begin();
             if (map_.size() > capacity_){
-                auto& [oldKey, _] = items_.back();
+                auto& [oldKey, oldValue] = items_.back();
+                PCACHE_PROBE2(lru_evict, std::hash<Key>{}(oldKey), map_.size() - 1);
+                on_evict(oldKey, oldValue);
                 map_.erase(oldKey);
                 items_.pop_back();
             }
@@ -56,6 +67,16 @@ class LRUCache {
             return capacity_;
         }
 
+        // Visits entries from least to most recently used as f(key, value); for snapshots.
+        template <typename F>
+        void for_each_lru_first(F&& f) const {
+            for (auto it = items_.rbegin(); it != items_.rend(); ++it) f(it->first, it->second);
+        }
+
+        void reserve(size_t n) {
+            map_.reserve(n);
+        }
+
         std::optional<Key> peek_lru_key() const {
             if (items_.empty()) {
                 return std::nullopt;
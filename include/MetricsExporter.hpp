@@ -0,0 +1,274 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "CacheCounters.hpp"
+#if defined(__unix__) || defined(__APPLE__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Renders the built-in per-shard counters (CacheCounters.hpp) of named caches as
+// Prometheus exposition text or JSON. Rendering reads the counter atomics only;
+// it never takes a shard lock, so scraping does not stall the caches.
+//
+//   MetricsRegistry metrics;
+//   metrics.add("sessions", session_cache);      // any cache with counters()
+//   MetricsHttpServer server(metrics, 9464);     // GET /metrics, /metrics.json
+//
+// Registered caches must outlive their registration (remove() or registry
+// destruction) and any server rendering the registry.
+class MetricsRegistry {
+public:
+    using Source = std::function<std::vector<CounterSnapshot>()>;
+
+    template <typename Cache>
+    void add(const std::string& name, const Cache& cache) {
+        add_source(name, [&cache] { return cache.counters(); });
+    }
+
+    void add_source(const std::string& name, Source src) {
+        std::scoped_lock l(mu_);
+        sources_.emplace_back(name, std::move(src));
+    }
+
+    void remove(const std::string& name) {
+        std::scoped_lock l(mu_);
+        for (auto it = sources_.begin(); it != sources_.end();) {
+            if (it->first == name) it = sources_.erase(it);
+            else ++it;
+        }
+    }
+
+    std::string prometheus() const {
+        const auto snap = collect();
+        std::ostringstream os;
+        for (const auto& m : kMetrics) {
+            os << "# HELP pcache_" << m.name << ' ' << m.help << "\n"
+               << "# TYPE pcache_" << m.name << ' ' << (m.gauge ? "gauge" : "counter") << "\n";
+            for (const auto& [name, shards] : snap)
+                for (size_t i = 0; i < shards.size(); ++i)
+                    os << "pcache_" << m.name << "{cache=\"" << escape(name) << "\",shard=\"" << i << "\"} "
+                       << shards[i].*m.field << "\n";
+        }
+        return os.str();
+    }
+
+    std::string json() const {
+        const auto snap = collect();
+        std::ostringstream os;
+        auto object = [&](const CounterSnapshot& c) {
+            os << '{';
+            for (size_t k = 0; k < kMetrics.size(); ++k)
+                os << (k ? ", " : "") << '"' << kMetrics[k].key << "\": " << c.*kMetrics[k].field;
+            os << '}';
+        };
+        os << "{\"caches\": [";
+        for (size_t n = 0; n < snap.size(); ++n) {
+            const auto& [name, shards] = snap[n];
+            CounterSnapshot totals;
+            for (const auto& s : shards) totals += s;
+            os << (n ? ", " : "") << "{\"name\": \"" << escape(name) << "\", \"totals\": ";
+            object(totals);
+            os << ", \"shards\": [";
+            for (size_t i = 0; i < shards.size(); ++i) {
+                os << (i ? ", " : "");
+                object(shards[i]);
+            }
+            os << "]}";
+        }
+        os << "]}\n";
+        return os.str();
+    }
+
+private:
+    struct Metric {
+        const char* key;    // JSON field
+        const char* name;   // Prometheus name, without the pcache_ prefix
+        const char* help;
+        bool gauge;
+        uint64_t CounterSnapshot::*field;
+    };
+    static inline const std::vector<Metric> kMetrics = {
+        {"hits", "hits_total", "get() calls that found the key.", false, &CounterSnapshot::hits},
+        {"misses", "misses_total", "get() calls that did not find the key.", false, &CounterSnapshot::misses},
+        {"puts", "puts_total", "put() calls.", false, &CounterSnapshot::puts},
+        {"evictions", "evictions_total", "Entries evicted to make room.", false, &CounterSnapshot::evictions},
+        {"admitted", "admitted_total", "New keys admitted by TinyLFU into a full shard.", false, &CounterSnapshot::admitted},
+        {"rejected", "rejected_total", "New keys refused by TinyLFU admission.", false, &CounterSnapshot::rejected},
+        {"prefetch_issued", "prefetch_issued_total", "Predicted keys inserted or handed to the prefetcher.", false, &CounterSnapshot::prefetch_issued},
+        {"prefetch_used", "prefetch_used_total", "Prefetched entries later hit.", false, &CounterSnapshot::prefetch_used},
+        {"prefetch_wasted", "prefetch_wasted_total", "Prefetched entries evicted or refused before any hit.", false, &CounterSnapshot::prefetch_wasted},
+        {"decay_runs", "decay_runs_total", "Predictor or sketch decay passes.", false, &CounterSnapshot::decay_runs},
+        {"size", "entries", "Entries currently cached.", true, &CounterSnapshot::size},
+        {"predictor_states", "predictor_states", "Source keys in the Markov transition table.", true, &CounterSnapshot::predictor_states},
+        {"predictor_edges", "predictor_edges", "Transitions in the Markov transition table.", true, &CounterSnapshot::predictor_edges},
+    };
+
+    std::vector<std::pair<std::string, std::vector<CounterSnapshot>>> collect() const {
+        std::scoped_lock l(mu_);
+        std::vector<std::pair<std::string, std::vector<CounterSnapshot>>> out;
+        for (const auto& [name, src] : sources_) out.emplace_back(name, src());
+        return out;
+    }
+
+    // label values and JSON strings share the same escapes for the characters that matter here
+    static std::string escape(const std::string& s) {
+        std::string out;
+        for (char c : s) {
+            if (c == '"' || c == '\\') out += '\\';
+            if (c == '\n') { out += "\\n"; continue; }
+            out += c;
+        }
+        return out;
+    }
+
+    mutable std::mutex mu_;
+    std::vector<std::pair<std::string, Source>> sources_;
+};
+
+// Minimal HTTP/1.0 endpoint for a MetricsRegistry on a background thread:
+// GET /metrics (Prometheus text) and GET /metrics.json; anything else is 404.
+// One connection at a time, closed after each response; a connection gets two
+// seconds in all to send its request and take the response, so a slow or
+// stalled client cannot hold up later scrapes. Binds to 127.0.0.1 by
+// default; port 0 picks a free port (see port()). POSIX only; the constructor
+// throws std::runtime_error elsewhere or if the socket cannot be bound.
+class MetricsHttpServer {
+public:
+    MetricsHttpServer(const MetricsRegistry& registry, uint16_t port, const std::string& bind_addr = "127.0.0.1")
+        : registry_(registry) {
+#if defined(__unix__) || defined(__APPLE__)
+        fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd_ < 0) throw std::runtime_error("metrics: socket() failed");
+        const int one = 1;
+        ::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (::inet_pton(AF_INET, bind_addr.c_str(), &addr.sin_addr) != 1 ||
+            ::bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd_, 16) != 0) {
+            ::close(fd_);
+            throw std::runtime_error("metrics: cannot listen on " + bind_addr + ":" + std::to_string(port));
+        }
+        socklen_t len = sizeof(addr);
+        ::getsockname(fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+        port_ = ntohs(addr.sin_port);
+        thread_ = std::thread([this] { serve(); });
+#else
+        (void)port;
+        (void)bind_addr;
+        throw std::runtime_error("metrics: HTTP endpoint needs POSIX sockets");
+#endif
+    }
+
+    ~MetricsHttpServer() { stop(); }
+
+    MetricsHttpServer(const MetricsHttpServer&) = delete;
+    MetricsHttpServer& operator=(const MetricsHttpServer&) = delete;
+
+    uint16_t port() const { return port_; }
+
+    void stop() {
+        if (!thread_.joinable()) return;
+        stop_ = true;
+        thread_.join();
+#if defined(__unix__) || defined(__APPLE__)
+        ::close(fd_);
+#endif
+    }
+
+private:
+#if defined(__unix__) || defined(__APPLE__)
+    void serve() {
+        while (!stop_.load()) {
+            pollfd p{fd_, POLLIN, 0};
+            if (::poll(&p, 1, 100) <= 0) continue;   // wake up regularly to notice stop()
+            const int c = ::accept(fd_, nullptr, nullptr);
+            if (c < 0) continue;
+            handle(c);
+            ::close(c);
+        }
+    }
+
+    using Clock = std::chrono::steady_clock;
+    static constexpr std::chrono::milliseconds kConnectionDeadline{2000};
+
+    // Waits until c is ready for `events` or the deadline passes; false on timeout or error.
+    static bool wait(int c, short events, Clock::time_point deadline) {
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        if (left <= 0) return false;
+        pollfd p{c, events, 0};
+        return ::poll(&p, 1, int(left)) > 0;
+    }
+
+    void handle(int c) {
+        const Clock::time_point deadline = Clock::now() + kConnectionDeadline;
+        // read up to the end of the request head
+        std::string req;
+        char buf[1024];
+        while (req.find("\r\n\r\n") == std::string::npos && req.size() < 8192) {
+            if (!wait(c, POLLIN, deadline)) return;
+            const ssize_t n = ::recv(c, buf, sizeof(buf), 0);
+            if (n <= 0) break;
+            req.append(buf, size_t(n));
+        }
+        const size_t sp1 = req.find(' '), sp2 = req.find(' ', sp1 + 1);
+        const std::string method = req.substr(0, sp1);
+        const std::string path = sp1 == std::string::npos ? "" : req.substr(sp1 + 1, sp2 - sp1 - 1);
+
+        std::string status = "200 OK", type, body;
+        if (method != "GET") {
+            status = "405 Method Not Allowed";
+            body = "GET only\n";
+        } else if (path == "/metrics") {
+            type = "text/plain; version=0.0.4";
+            body = registry_.prometheus();
+        } else if (path == "/metrics.json") {
+            type = "application/json";
+            body = registry_.json();
+        } else {
+            status = "404 Not Found";
+            body = "try /metrics or /metrics.json\n";
+        }
+        if (type.empty()) type = "text/plain";
+        const std::string head = "HTTP/1.0 " + status + "\r\nContent-Type: " + type +
+                                 "\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+        if (send_all(c, head, deadline)) send_all(c, body, deadline);
+    }
+
+    static bool send_all(int c, const std::string& s, Clock::time_point deadline) {
+        size_t off = 0;
+        while (off < s.size()) {
+            if (!wait(c, POLLOUT, deadline)) return false;
+#if defined(MSG_NOSIGNAL)
+            const ssize_t n = ::send(c, s.data() + off, s.size() - off, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+            const ssize_t n = ::send(c, s.data() + off, s.size() - off, MSG_DONTWAIT);
+#endif
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) continue;
+            if (n <= 0) return false;
+            off += size_t(n);
+        }
+        return true;
+    }
+
+    int fd_ = -1;
+#endif
+    const MetricsRegistry& registry_;
+    uint16_t port_ = 0;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
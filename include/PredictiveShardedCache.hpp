@@ -3,8 +3,13 @@
 #include <mutex>
 #include <optional>
 #include <memory>
+#include <functional>
+#include <string>
 #include "ShardedWTinyLFU.hpp"
 #include "MarkovPredictor.hpp"
+#include "StageTimer.hpp"
+#include "CacheCounters.hpp"
+#include "Probes.hpp"
 
 // Adds Markov prefetch/protect to ShardedWTinyLFU.
 // Prefetch policy: on get(k), prefetch top-P predicted next keys for the same shard.
@@ -17,42 +22,120 @@ public:
         uint32_t min_trans_count = 4;
         double min_trans_prob = 0.2;
         bool enable_prefetch = true;      // if false, only "protects" via admission/recency
+        size_t cms_width = 4096;          // per-shard TinyLFU sketch, power of two
+        size_t cms_depth = 4;
+    };
+
+    // Counter snapshot. Per shard: get/put/prefetch-issued/predictor/decay counts
+    // of this layer; eviction, admission, prefetch used/wasted and size of the
+    // base shard with the same index (both layers route by hash % shards).
+    struct Stats {
+        CounterSnapshot totals;             // all zero with PCACHE_DISABLE_STATS
+        std::vector<CounterSnapshot> shards;
+        std::vector<HotKey<Key>> hot_keys;  // hottest keys over all shards, from the base cache
+        CardinalityEstimate distinct;       // from the base cache
+    };
+
+    // Sampled per-stage cost of get(), see StageTimer.hpp. Empty unless built with
+    // PCACHE_STAGE_TIMING.
+    struct StageStats {
+        bool enabled = false;
+        double ticks_per_ns = 1.0;              // divide histogram values by this for ns
+        std::vector<StageHistograms> shards;    // per shard, indexed by GetStage, in ticks
     };
 
     PredictiveShardedCache(size_t capacity, const Options& opt = Options{})
-        : base_(capacity, opt.shards), opts_(opt),
-          preds_(opt.shards), locks_(opt.shards), prev_(opt.shards) {}
+        : base_(capacity, opt.shards, opt.cms_width, opt.cms_depth), opts_(opt),
+          preds_(opt.shards), locks_(opt.shards), prev_(opt.shards), counters_(opt.shards)
+#if defined(PCACHE_STAGE_TIMING)
+          , stage_hist_(opt.shards)
+#endif
+    {}
+
+    // Receives each predicted key that is not cached, after the shard lock is released.
+    // It should start loading the value and hand it to put_prefetched() when ready;
+    // placeholders are not inserted while a prefetcher is set. Set before the cache
+    // is shared between threads.
+    using Prefetcher = std::function<void(const Key&)>;
+    void set_prefetcher(Prefetcher fn) { prefetcher_ = std::move(fn); }
+
+    // Receives, under the shard locks, each entry evicted to make room for a
+    // prefetch: a placeholder inserted by get() or a put_prefetched() value.
+    // Evictions by put() go to its own on_evict. TieredCache sets this to spill
+    // them into its tier. Set before the cache is shared between threads.
+    using EvictHandler = std::function<void(Key&, Value&)>;
+    void set_prefetch_evict_handler(EvictHandler fn) { prefetch_evict_ = std::move(fn); }
 
     std::optional<Value> get(const Key& key) {
         const size_t i = shidx(key);
-        std::scoped_lock lk(locks_[i]);
+        std::optional<Value> result;
+        std::vector<Key> to_fetch;
+#if defined(PCACHE_STAGE_TIMING)
+        StageTimer timer(stage_timing::sample());
+#else
+        NullStageTimer timer;
+#endif
+        {
+            std::scoped_lock lk(locks_[i]);
+            timer.mark(GetStage::kLock);
 
-        // learn transition: prev_i -> key
-        if (prev_[i].has_value()) {
-            preds_[i].observe(*prev_[i], key);
-        }
-        prev_[i] = key;
+            ShardCounters& c = counters_[i];
+
+            // learn transition: prev_i -> key
+            if (prev_[i].has_value()) {
+                preds_[i].observe(*prev_[i], key);
+                c.predictor_states.set(preds_[i].num_states());
+                c.predictor_edges.set(preds_[i].num_edges());
+            }
+            prev_[i] = key;
+            timer.mark(GetStage::kObserve);
 
-        auto result = base_.get(key);
+            result = base_.get(key, timer);
+            (result ? c.hits : c.misses).add();
+            PCACHE_PROBE4(get, 3, i, hasher_(key), result.has_value());
+            timer.mark(GetStage::kBaseLookup);
 
-        if (opts_.enable_prefetch) {
-            auto cand = preds_[i].topk_next(key, opts_.prefetch_topk,
-                                            opts_.min_trans_count, opts_.min_trans_prob);
-            for (const auto& nxt : cand) {
-                // simple prefetch: insert placeholder if not present
-                if (!base_.get(nxt)) {
-                    base_.put(nxt, Value{}); // default-constructed value as a stand-in
+            if (opts_.enable_prefetch) {
+                auto cand = preds_[i].topk_next(key, opts_.prefetch_topk,
+                                                opts_.min_trans_count, opts_.min_trans_prob);
+                timer.mark(GetStage::kTopK);
+                for (const auto& nxt : cand) {
+                    if (base_.touch(nxt)) continue;
+                    c.prefetch_issued.add();
+                    PCACHE_PROBE3(prefetch, i, hasher_(nxt), prefetcher_ ? 1 : 0);
+                    if (prefetcher_) to_fetch.push_back(nxt);
+                    else prefetch_insert(nxt, Value{}); // simple prefetch: default-constructed stand-in
                 }
+                timer.mark(GetStage::kPrefetch);
             }
+#if defined(PCACHE_STAGE_TIMING)
+            timer.record_into(stage_hist_[i]);
+#endif
         }
+        for (const auto& nxt : to_fetch) prefetcher_(nxt);
         return result;
     }
 
     void put(const Key& key, const Value& value) {
+        put(key, value, [](Key&, Value&) {});
+    }
+
+    // put() that hands an evicted entry to on_evict(Key&, Value&), called under the shard locks.
+    template <typename OnEvict>
+    typename ShardedWTinyLFU<Key, Value>::PutOutcome put(const Key& key, const Value& value, OnEvict&& on_evict) {
         const size_t i = shidx(key);
         std::scoped_lock lk(locks_[i]);
-        base_.put(key, value);
+        const auto r = base_.put(key, value, on_evict);
+        counters_[i].puts.add();
         prev_[i] = key; // treat put as an access for sequence learning
+        return r;
+    }
+
+    // Insert a value loaded by the prefetcher. Unlike put(), not an access for sequence learning.
+    void put_prefetched(const Key& key, const Value& value) {
+        const size_t i = shidx(key);
+        std::scoped_lock lk(locks_[i]);
+        prefetch_insert(key, value);
     }
 
     bool erase(const Key& key) {
@@ -61,25 +144,182 @@ public:
         return base_.erase(key);
     }
 
+    size_t size() { return base_.size(); }
+
     size_t num_shards() const { return opts_.shards; }
 
+    // Per-shard contention on this layer's locks (the base cache's are in
+    // base_lock_stats()); empty unless built with PCACHE_LOCK_STATS.
+    std::vector<LockStats> lock_stats() { return collect_lock_stats(locks_); }
+    std::vector<LockStats> base_lock_stats() { return base_.lock_stats(); }
+    void reset_lock_stats() {
+        clear_lock_stats(locks_);
+        base_.reset_lock_stats();
+    }
+
     // Optional: call occasionally
     void decay_models() {
         for (size_t i = 0; i < preds_.size(); ++i) {
             std::scoped_lock lk(locks_[i]);
             preds_[i].decay_half();
+            ShardCounters& c = counters_[i];
+            c.decay_runs.add();
+            c.predictor_states.set(preds_[i].num_states());
+            c.predictor_edges.set(preds_[i].num_edges());
         }
     }
 
+    // The counters are read without locks; the hot keys come from base_.hot_keys(),
+    // which takes each base shard lock briefly.
+    Stats stats() {
+        Stats st;
+        st.shards = counters();
+        for (const auto& c : st.shards) st.totals += c;
+        st.hot_keys = hot_keys();
+        st.distinct = distinct_keys();
+        return st;
+    }
+
+    // The k most frequently read keys with estimated get counts. Prefetch
+    // candidate checks are not counted.
+    std::vector<HotKey<Key>> hot_keys(size_t k = 10) { return base_.hot_keys(k); }
+
+    // Distinct keys read per window, from the base cache; see ShardedWTinyLFU.
+    CardinalityEstimate distinct_keys() { return base_.distinct_keys(); }
+    void rotate_distinct_window() { base_.rotate_distinct_window(); }
+
+    std::vector<CounterSnapshot> counters() const {
+        std::vector<CounterSnapshot> out;
+        const auto base = base_.counters();
+        for (size_t i = 0; i < counters_.size(); ++i) {
+            CounterSnapshot s = CounterSnapshot::of(counters_[i]);
+            s.evictions = base[i].evictions;
+            s.admitted = base[i].admitted;
+            s.rejected = base[i].rejected;
+            s.prefetch_used = base[i].prefetch_used;
+            s.prefetch_wasted = base[i].prefetch_wasted;
+            s.size = base[i].size;
+            out.push_back(s);
+        }
+        return out;
+    }
+
+    // save()/load() of ShardedWTinyLFU plus the Markov predictors: one snapshot
+    // section of transitions per shard. load() restores the predictors when the
+    // snapshot has them (re-routed by source key if the shard count changed) and
+    // forgets each shard's previous key.
+    template <typename KeyCodec = SnapshotCodec<Key>, typename ValueCodec = SnapshotCodec<Value>>
+    void save(const std::string& path, const KeyCodec& kc = KeyCodec{}, const ValueCodec& vc = ValueCodec{}) {
+        SnapshotWriter w(base_.snapshot_geometry());
+        base_.add_snapshot_sections(w, kc, vc);
+        const size_t n = preds_.size();
+        std::vector<std::string> out(n);
+        std::vector<uint64_t> counts(n, 0);
+        snapshot_detail::parallel_for(n, [&](size_t i) {
+            std::scoped_lock lk(locks_[i]);
+            preds_[i].for_each_transition([&](const Key& prev, const Key& cur, uint32_t count, uint32_t total) {
+                kc.encode(out[i], prev);
+                kc.encode(out[i], cur);
+                snapshot_detail::append_pod(out[i], count);
+                snapshot_detail::append_pod(out[i], total);
+                ++counts[i];
+            });
+        });
+        for (size_t i = 0; i < n; ++i) w.add(SnapshotSection::kPredictor, i, counts[i], std::move(out[i]));
+        w.write(path);
+    }
+
+    template <typename KeyCodec = SnapshotCodec<Key>, typename ValueCodec = SnapshotCodec<Value>>
+    void load(const std::string& path, const KeyCodec& kc = KeyCodec{}, const ValueCodec& vc = ValueCodec{}) {
+        SnapshotFile f(path);
+        if (!f.has_predictor()) {
+            base_.restore_snapshot(f, kc, vc);
+            return;
+        }
+        // predictors are decoded first, so a bad section leaves the cache untouched
+        const size_t n = preds_.size();
+        const bool same_shards = f.geometry().shards == n;
+        std::vector<MarkovPredictor<Key>> fresh(n);
+        std::vector<std::mutex> route_mu(same_shards ? 0 : n);
+        const auto sections = f.sections(SnapshotSection::kPredictor);
+        snapshot_detail::parallel_for(sections.size(), [&](size_t s) {
+            const auto& sec = *sections[s];
+            SnapshotReader in = SnapshotFile::open(sec);
+            for (uint64_t e = 0; e < sec.items; ++e) {
+                const Key prev = kc.decode(in);
+                const Key cur = kc.decode(in);
+                const uint32_t count = in.pod<uint32_t>(), total = in.pod<uint32_t>();
+                if (same_shards) {
+                    fresh[sec.shard].restore_transition(prev, cur, count, total);
+                } else {
+                    const size_t i = shidx(prev);
+                    std::scoped_lock l(route_mu[i]);
+                    fresh[i].restore_transition(prev, cur, count, total);
+                }
+            }
+        });
+        base_.restore_snapshot(f, kc, vc);
+        for (size_t i = 0; i < n; ++i) {
+            std::scoped_lock lk(locks_[i]);
+            std::swap(preds_[i], fresh[i]);
+            prev_[i].reset();
+            counters_[i].predictor_states.set(preds_[i].num_states());
+            counters_[i].predictor_edges.set(preds_[i].num_edges());
+        }
+    }
+
+    // Checkpoint log of the base cache (see ShardedWTinyLFU::enable_checkpoint_log).
+    // Its snapshots hold the cached entries only, not the predictors.
+    template <typename KeyCodec = SnapshotCodec<Key>, typename ValueCodec = SnapshotCodec<Value>>
+    void enable_checkpoint_log(const std::string& dir, const CheckpointLogOptions& opt = CheckpointLogOptions{},
+                               const KeyCodec& kc = KeyCodec{}, const ValueCodec& vc = ValueCodec{}) {
+        base_.enable_checkpoint_log(dir, opt, kc, vc);
+    }
+    void checkpoint() { base_.checkpoint(); }
+    void flush_checkpoint_log() { base_.flush_checkpoint_log(); }
+
+    StageStats stage_stats() {
+        StageStats st;
+#if defined(PCACHE_STAGE_TIMING)
+        st.enabled = true;
+        st.ticks_per_ns = cycle_clock::ticks_per_ns();
+        for (size_t i = 0; i < stage_hist_.size(); ++i) {
+            std::scoped_lock lk(locks_[i]);
+            st.shards.push_back(stage_hist_[i]);
+        }
+#endif
+        return st;
+    }
+
+    void reset_stage_stats() {
+#if defined(PCACHE_STAGE_TIMING)
+        for (size_t i = 0; i < stage_hist_.size(); ++i) {
+            std::scoped_lock lk(locks_[i]);
+            for (auto& h : stage_hist_[i]) h.reset();
+        }
+#endif
+    }
+
 private:
     size_t shidx(const Key& k) const { return hasher_(k) % opts_.shards; }
 
+    void prefetch_insert(const Key& key, const Value& value) {
+        if (prefetch_evict_) base_.put_prefetched(key, value, prefetch_evict_);
+        else base_.put_prefetched(key, value);
+    }
+
     ShardedWTinyLFU<Key, Value> base_;
     Options opts_;
 
     // per-shard predictor + last key seen
     std::vector<MarkovPredictor<Key>> preds_;
     std::vector<std::optional<Key>> prev_;
-    std::vector<std::mutex> locks_;
+    std::vector<ShardMutex> locks_;
+    std::vector<ShardCounters> counters_; // written under locks_[i]
     std::hash<Key> hasher_;
+    Prefetcher prefetcher_;
+    EvictHandler prefetch_evict_;
+#if defined(PCACHE_STAGE_TIMING)
+    std::vector<StageHistograms> stage_hist_; // guarded by locks_[i]
+#endif
 };
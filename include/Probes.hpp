@@ -0,0 +1,48 @@
+#pragma once
+
+// Optional USDT (statically defined tracing) probes, provider "pcache". Build with
+// PCACHE_ENABLE_SDT (CMake option of the same name; needs <sys/sdt.h> from
+// systemtap-sdt-dev / systemtap-sdt-devel). An unattached probe is a single nop
+// in the instruction stream; its arguments are still materialized in registers,
+// and key hashes are computed for them where the code had none, so the probes
+// are compiled out entirely unless the switch is set. List them with
+// `readelf -n <binary>` or `bpftrace -l 'usdt:<binary>:pcache:*'`.
+//
+// Probe arguments (all integers; key_hash is std::hash<Key> of the key, the
+// same value the sharded caches route by; cache is 1 = ShardedLRU,
+// 2 = ShardedWTinyLFU, 3 = PredictiveShardedCache, 4 = ShardedSlabCache):
+//
+//   lru_evict(key_hash, size)                       LRUCache evicted its LRU entry
+//   tinylfu_admission(key_hash, victim_hash, new_est, victim_est, admitted)
+//                                                   TinyLFUAdmittingLRU admission duel
+//   markov_new_edge(prev_hash, cur_hash, edges)     MarkovPredictor learned a new transition
+//   markov_decay(states, edges_before, edges_after) MarkovPredictor::decay_half finished
+//   get(cache, shard, key_hash, hit)                sharded get() result
+//   put(cache, shard, key_hash, outcome)            sharded put(); outcome as PutOutcome
+//                                                   (0 updated, 1 inserted, 2 admitted with
+//                                                   eviction, 3 rejected); ShardedLRU reports
+//                                                   1, or 2 when the put evicted;
+//                                                   ShardedSlabCache its own PutOutcome,
+//                                                   numbered the same
+//   evict(cache, shard, key_hash, reason)           entry left a shard; reason 0 = capacity,
+//                                                   1 = capacity, was an unused prefetch,
+//                                                   2 = erase()
+//   prefetch(shard, key_hash, async)                PredictiveShardedCache issued a prefetch;
+//                                                   async = 1 when handed to the prefetcher
+//   lock_wait(mutex, wait_ticks)                    a shard lock was contended; mutex is its
+//                                                   address, wait in cycle_clock ticks
+//
+//   bpftrace -e 'usdt:./app:pcache:tinylfu_admission /arg4 == 0/ { @rejects = count(); }'
+//   bpftrace -e 'usdt:./app:pcache:lock_wait { @wait_ticks = hist(arg1); }'
+#if defined(PCACHE_ENABLE_SDT)
+#include <sys/sdt.h>
+#define PCACHE_PROBE2(name, a, b) DTRACE_PROBE2(pcache, name, a, b)
+#define PCACHE_PROBE3(name, a, b, c) DTRACE_PROBE3(pcache, name, a, b, c)
+#define PCACHE_PROBE4(name, a, b, c, d) DTRACE_PROBE4(pcache, name, a, b, c, d)
+#define PCACHE_PROBE5(name, a, b, c, d, e) DTRACE_PROBE5(pcache, name, a, b, c, d, e)
+#else
+#define PCACHE_PROBE2(name, a, b) do {} while (0)
+#define PCACHE_PROBE3(name, a, b, c) do {} while (0)
+#define PCACHE_PROBE4(name, a, b, c, d) do {} while (0)
+#define PCACHE_PROBE5(name, a, b, c, d, e) do {} while (0)
+#endif
@@ -0,0 +1,155 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "TinyLFUAdmittingLRU.hpp"
+
+// Estimated hit rate of the cache if it had `factor` times its real capacity.
+struct ShadowEstimate {
+    double factor = 0.0;
+    size_t virtual_capacity = 0;   // factor * real capacity, in entries
+    uint64_t accesses = 0;         // sampled get() calls seen by this shadow
+    uint64_t hits = 0;
+    double hit_rate = 0.0;         // sample-size adjusted, see ShadowCacheSet::estimates
+};
+
+// Metadata-only replicas of the TinyLFU-LRU policy at several virtual capacities.
+// Keys are sampled by hash (SHARDS-style): a sampled key is always sampled, so each
+// shadow sees the complete reuse pattern of ~rate of the keyspace and only needs
+// rate * virtual_capacity slots. Values are not stored.
+//
+// Like the cache it shadows, the set is split into `partitions` (the cache's
+// shard count), each with its share of every virtual capacity and its own
+// lock, so sampled accesses of different shards never contend. Small shadows
+// get fewer partitions (a divisor of the shard count, shared modulo it) so
+// that every part keeps at least kMinPartitionSlots slots. Callers pass the
+// shard index and an already mixed 64-bit key hash (see mix64 in KeyHash.hpp).
+class ShadowCacheSet {
+public:
+    ShadowCacheSet(size_t capacity, const std::vector<double>& factors, double sample_rate,
+                   size_t total_cms_width, size_t cms_depth, size_t partitions = 1)
+        : threshold_(static_cast<uint64_t>(sample_rate * double(kSampleSpace)))
+    {
+        if (sample_rate <= 0.0 || sample_rate > 1.0) throw std::invalid_argument("sample_rate must be in (0, 1]");
+        if (factors.empty()) throw std::invalid_argument("factors must not be empty");
+        if (partitions == 0) throw std::invalid_argument("partitions must be > 0");
+        for (double f : factors)
+            if (f <= 0.0) throw std::invalid_argument("factors must be > 0");
+        // keep the sketch counters-per-entry ratio of the real cache
+        const double per_entry = capacity ? double(total_cms_width) / double(capacity) : 1.0;
+        // round each shadow's sampled size once and split it across partitions, so the
+        // parts add up to it; fewer partitions when the smallest would be starved
+        std::vector<size_t> vcaps, totals;
+        for (double f : factors) {
+            vcaps.push_back(static_cast<size_t>(std::llround(f * double(capacity))));
+            totals.push_back(std::max<size_t>(1, static_cast<size_t>(std::llround(double(vcaps.back()) * sample_rate))));
+        }
+        const size_t smallest = *std::min_element(totals.begin(), totals.end());
+        // a divisor of the shard count, so shards map evenly onto the parts
+        const size_t limit = std::max<size_t>(1, smallest / kMinPartitionSlots);
+        while (partitions > limit) {
+            size_t d = limit;
+            while (partitions % d) --d;
+            partitions = d;
+        }
+        parts_ = std::vector<Partition>(partitions);
+        for (size_t i = 0; i < partitions; ++i) {
+            for (size_t f = 0; f < factors.size(); ++f) {
+                Shadow s;
+                s.factor = factors[f];
+                s.virtual_capacity = vcaps[f];
+                const size_t cap = totals[f] / partitions + (i < totals[f] % partitions ? 1 : 0);
+                const size_t width = pow2_ceil(std::max<size_t>(16, static_cast<size_t>(per_entry * double(cap))));
+                s.cache = std::make_unique<TinyLFUAdmittingLRU<uint64_t, uint8_t>>(cap, width, cms_depth);
+                parts_[i].shadows.push_back(std::move(s));
+            }
+        }
+    }
+
+    bool sampled(uint64_t h) const { return (h >> 40) < threshold_; }
+
+    // get() on the real cache; the shadow fills itself on a miss only when put() follows,
+    // exactly like the real one.
+    void on_get(size_t shard, uint64_t h) {
+        if (!sampled(h)) return;
+        Partition& p = parts_[shard % parts_.size()];
+        std::scoped_lock l(p.mu);
+        for (auto& s : p.shadows) {
+            ++s.accesses;
+            if (s.cache->get(h)) ++s.hits;
+        }
+    }
+
+    void on_put(size_t shard, uint64_t h) {
+        if (!sampled(h)) return;
+        Partition& p = parts_[shard % parts_.size()];
+        std::scoped_lock l(p.mu);
+        for (auto& s : p.shadows) s.cache->put(h, 0);
+    }
+
+    void on_erase(size_t shard, uint64_t h) {
+        if (!sampled(h)) return;
+        Partition& p = parts_[shard % parts_.size()];
+        std::scoped_lock l(p.mu);
+        for (auto& s : p.shadows) s.cache->erase(h);
+    }
+
+    // total_gets is the unsampled get() count of the real cache. Under skew a handful of
+    // hot keys decide whether the sample over- or under-represents the stream; following
+    // SHARDS-adj the shortfall against total_gets * rate is credited as hits (hot keys hit
+    // at any capacity), and any excess is removed from them.
+    std::vector<ShadowEstimate> estimates(uint64_t total_gets) const {
+        std::vector<ShadowEstimate> out(parts_[0].shadows.size());
+        for (size_t f = 0; f < out.size(); ++f) {
+            out[f].factor = parts_[0].shadows[f].factor;
+            out[f].virtual_capacity = parts_[0].shadows[f].virtual_capacity;
+        }
+        for (const auto& p : parts_) {
+            std::scoped_lock l(p.mu);
+            for (size_t f = 0; f < out.size(); ++f) {
+                out[f].accesses += p.shadows[f].accesses;
+                out[f].hits += p.shadows[f].hits;
+            }
+        }
+        const double expected = double(total_gets) * double(threshold_) / double(kSampleSpace);
+        for (auto& e : out) {
+            if (expected >= 1.0) {
+                const double adj_hits = double(e.hits) + (expected - double(e.accesses));
+                e.hit_rate = std::clamp(adj_hits / expected, 0.0, 1.0);
+            } else {
+                e.hit_rate = e.accesses ? double(e.hits) / double(e.accesses) : 0.0;
+            }
+        }
+        return out;
+    }
+
+private:
+    static constexpr uint64_t kSampleSpace = 1ULL << 24; // compared against the top 24 hash bits
+    static constexpr size_t kMinPartitionSlots = 32;      // per shadow, below which partitions merge
+
+    static size_t pow2_ceil(size_t x) {
+        size_t p = 1;
+        while (p < x) p <<= 1;
+        return p;
+    }
+
+    struct Shadow {
+        double factor;
+        size_t virtual_capacity;
+        uint64_t accesses = 0;
+        uint64_t hits = 0;
+        std::unique_ptr<TinyLFUAdmittingLRU<uint64_t, uint8_t>> cache;
+    };
+
+    struct alignas(64) Partition {
+        mutable std::mutex mu;
+        std::vector<Shadow> shadows;   // one per factor
+    };
+
+    uint64_t threshold_;
+    std::vector<Partition> parts_;
+};
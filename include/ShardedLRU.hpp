@@ -6,11 +6,28 @@
 #include <functional>
 #include <stdexcept>
 #include "LRUCache.hpp"
+#include "InstrumentedMutex.hpp"
+#include "CacheCounters.hpp"
+#include "HeavyHitters.hpp"
+#include "HyperLogLog.hpp"
+#include "KeyHash.hpp"
+#include "Probes.hpp"
 
 template <typename Key, typename Value>
 class ShardedLRU {
     public:
-        ShardedLRU(size_t capacity, size_t num_shards) : locks_(num_shards), shards_(num_shards) {
+        struct Stats {
+            size_t capacity = 0;
+            CounterSnapshot totals;             // sum over shards; all zero with PCACHE_DISABLE_STATS
+            std::vector<CounterSnapshot> shards;
+            std::vector<HotKey<Key>> hot_keys;  // hottest keys over all shards, see hot_keys()
+            CardinalityEstimate distinct;       // see distinct_keys()
+        };
+
+        ShardedLRU(size_t capacity, size_t num_shards)
+            : locks_(num_shards), shards_(num_shards), counters_(num_shards), hot_(num_shards),
+              distinct_(kStatsEnabled ? num_shards : 0, WindowedHyperLogLog(PCACHE_HLL_WINDOWS, PCACHE_HLL_PRECISION)),
+              capacity_(capacity) {
             if (num_shards == 0) {
                 throw std::invalid_argument("num_shards must be > 0");
             }
@@ -23,21 +40,46 @@ class ShardedLRU {
         }
 
         std::optional<Value> get(const Key& key) {
-            const size_t i = shard_idx(key); // hash function
+            const size_t h = hasher_(key);
+            const size_t i = h % shards_.size();
             std::scoped_lock lock(locks_[i]);
-            return shards_[i]->get(key);
+            auto v = shards_[i]->get(key);
+            (v ? counters_[i].hits : counters_[i].misses).add();
+            hot_.on_get(i, key);
+            if constexpr (kStatsEnabled) distinct_[i].add(mix64(h));
+            PCACHE_PROBE4(get, 1, i, h, v.has_value());
+            return v;
         }
 
         void put(const Key& key, const Value& value){
+            put(key, value, [](Key&, Value&) {});
+        }
+
+        // put() that hands the evicted entry, if any, to on_evict(Key&, Value&), called under the shard lock.
+        template <typename OnEvict>
+        void put(const Key& key, const Value& value, OnEvict&& on_evict){
             const size_t i = shard_idx(key);
             std::scoped_lock lock(locks_[i]);
-            shards_[i]->put(key, value);
+            ShardCounters& c = counters_[i];
+            [[maybe_unused]] bool evicted = false;
+            shards_[i]->put(key, value, [&](Key& k, Value& v) {
+                c.evictions.add();
+                evicted = true;
+                PCACHE_PROBE4(evict, 1, i, hasher_(k), 0);
+                on_evict(k, v);
+            });
+            c.puts.add();
+            PCACHE_PROBE4(put, 1, i, hasher_(key), evicted ? 2 : 1);
+            c.size.set(shards_[i]->size());
         }
 
         bool erase(const Key& key) {
             const size_t i = shard_idx(key);
             std::scoped_lock lock(locks_[i]);
-            return shards_[i]->erase(key);
+            const bool erased = shards_[i]->erase(key);
+            if (erased) PCACHE_PROBE4(evict, 1, i, hasher_(key), 2);
+            counters_[i].size.set(shards_[i]->size());
+            return erased;
         }
 
         bool contains(const Key& key){
@@ -59,14 +101,74 @@ class ShardedLRU {
             return shards_.size();
         }
 
+        // Counter snapshot plus the hottest keys. The counters are read without
+        // locks; copying the hot keys takes each shard lock briefly.
+        Stats stats() {
+            Stats st;
+            st.capacity = capacity_;
+            st.shards = counters();
+            for (const auto& c : st.shards) st.totals += c;
+            st.hot_keys = hot_keys();
+            st.distinct = distinct_keys();
+            return st;
+        }
+
+        // The k most frequently read keys over all shards with estimated get counts,
+        // from a sample of gets (HeavyHitters.hpp). Empty with PCACHE_DISABLE_STATS.
+        std::vector<HotKey<Key>> hot_keys(size_t k = 10) {
+            std::vector<HotKey<Key>> out;
+            for (size_t i = 0; i < shards_.size(); ++i) {
+                std::scoped_lock lock(locks_[i]);
+                hot_.collect(i, out);
+            }
+            ShardedHotKeys<Key>::rank(out, k);
+            return out;
+        }
+
+        // Distinct keys read per window and the capacity and cms_width they
+        // suggest (HyperLogLog.hpp). Empty with PCACHE_DISABLE_STATS.
+        CardinalityEstimate distinct_keys() {
+            std::vector<WindowedHyperLogLog> copies;
+            copies.reserve(distinct_.size());
+            for (size_t i = 0; i < distinct_.size(); ++i) {
+                std::scoped_lock lock(locks_[i]);
+                copies.push_back(distinct_[i]);
+            }
+            return estimate_cardinality(copies, capacity_);
+        }
+
+        // Starts a new distinct-key window and drops the oldest of PCACHE_HLL_WINDOWS.
+        // Call on a timer; the window length is up to the caller.
+        void rotate_distinct_window() {
+            for (size_t i = 0; i < distinct_.size(); ++i) {
+                std::scoped_lock lock(locks_[i]);
+                distinct_[i].rotate();
+            }
+        }
+
+        std::vector<CounterSnapshot> counters() const {
+            std::vector<CounterSnapshot> out;
+            out.reserve(counters_.size());
+            for (const auto& c : counters_) out.push_back(CounterSnapshot::of(c));
+            return out;
+        }
+
+        // Per-shard lock contention; empty unless built with PCACHE_LOCK_STATS.
+        std::vector<LockStats> lock_stats() { return collect_lock_stats(locks_); }
+        void reset_lock_stats() { clear_lock_stats(locks_); }
+
     
     private:
         size_t shard_idx(const Key& key) const {
             return hasher_(key) % shards_.size();
         }
 
-        std::vector<std::mutex> locks_;
+        std::vector<ShardMutex> locks_;
         std::vector<std::unique_ptr<LRUCache<Key, Value>>> shards_;
+        std::vector<ShardCounters> counters_; // written under locks_[i]
+        ShardedHotKeys<Key> hot_;             // shard i guarded by locks_[i]
+        std::vector<WindowedHyperLogLog> distinct_; // guarded by locks_[i]; empty with PCACHE_DISABLE_STATS
         std::hash<Key> hasher_;
+        size_t capacity_;
 
 };
\ No newline at end of file
@@ -0,0 +1,351 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "SlabAllocator.hpp"
+#include "Snapshot.hpp"
+#include "InstrumentedMutex.hpp"
+#include "CacheCounters.hpp"
+#include "KeyHash.hpp"
+#include "Probes.hpp"
+
+// Sharded LRU cache whose capacity is a byte budget and whose entries live in
+// slab memory (SlabAllocator.hpp) rather than in std::list/unordered_map
+// nodes. Each shard owns an allocator of capacity_bytes / shards and stores an
+// entry as one chunk: a SlabItem header, then the key and value encoded with
+// their codecs (SnapshotCodec by default). Entries of one size class form an
+// LRU list through the headers, and a put that finds its class full evicts
+// that class's least recently used entry (memcached's policy); a class with no
+// pages takes one from the class with the most. The only other memory is an
+// open-addressing index of 8 bytes per slot, so the heap holds a few large
+// blocks that are allocated once, and the resident size stays near the budget
+// however long the cache runs and however value sizes shift.
+//
+// Capacity counts what an entry really costs: its whole chunk, including the
+// 32-byte header and the rounding up to the class size (at most 25%). get()
+// decodes a copy of the value, like the other caches return copies. Entries
+// larger than a slab page are not stored; put() returns kRejected for them,
+// like a TinyLFU rejection, so TieredCache keeps them in its tier. Keys are
+// indexed by their 64-bit std::hash; a new key whose hash equals a cached one's
+// replaces it (it is evicted).
+template <typename Key, typename Value, typename KeyCodec = SnapshotCodec<Key>,
+          typename ValueCodec = SnapshotCodec<Value>>
+class ShardedSlabCache {
+public:
+    enum class PutOutcome {
+        kUpdated,    // key was present; value replaced
+        kInserted,   // stored without evicting anything
+        kEvicted,    // stored after evicting entries of its size class
+        kRejected    // not stored: larger than a page; any old value of the key is gone
+    };
+
+    struct Stats {
+        size_t capacity_bytes = 0;
+        uint64_t reserved_bytes = 0;   // slab pages taken from the heap, at most the capacity
+        uint64_t used_bytes = 0;       // chunks holding entries
+        uint64_t item_bytes = 0;       // headers, keys and values in those chunks
+        uint64_t index_bytes = 0;
+        CounterSnapshot totals;        // rejected: puts larger than a page (PutOutcome::kRejected)
+        std::vector<CounterSnapshot> shards;
+    };
+
+    ShardedSlabCache(size_t capacity_bytes, size_t num_shards, size_t page_bytes = size_t(1) << 20,
+                     const KeyCodec& kc = KeyCodec{}, const ValueCodec& vc = ValueCodec{})
+        : locks_(num_shards), counters_(num_shards), kc_(kc), vc_(vc), capacity_(capacity_bytes) {
+        if (num_shards == 0) throw std::invalid_argument("num_shards must be > 0");
+        if (capacity_bytes / num_shards < page_bytes)
+            throw std::invalid_argument("capacity_bytes must hold a slab page per shard");
+        shards_.reserve(num_shards);
+        for (size_t i = 0; i < num_shards; ++i) shards_.push_back(std::make_unique<Shard>(capacity_bytes / num_shards, page_bytes));
+    }
+
+    std::optional<Value> get(const Key& key) {
+        const uint64_t h = hasher_(key);
+        const size_t i = h % shards_.size();
+        std::string& probe = scratch();
+        probe.clear();
+        kc_.encode(probe, key);
+        std::scoped_lock l(locks_[i]);
+        Shard& s = *shards_[i];
+        SlabItem* it = find(s, h, probe);
+        PCACHE_PROBE4(get, 4, i, h, it != nullptr);
+        if (!it) {
+            counters_[i].misses.add();
+            return std::nullopt;
+        }
+        counters_[i].hits.add();
+        s.lru.touch(it);
+        SnapshotReader in(it->data() + probe.size(), it->size - probe.size());
+        return vc_.decode(in);
+    }
+
+    PutOutcome put(const Key& key, const Value& value) { return insert<false>(key, value, [](Key&, Value&) {}); }
+
+    // put() that hands every entry it evicts to on_evict(Key&, Value&), called
+    // under the shard lock. Evicted entries are decoded for it.
+    template <typename OnEvict>
+    PutOutcome put(const Key& key, const Value& value, OnEvict&& on_evict) {
+        return insert<true>(key, value, on_evict);
+    }
+
+    bool erase(const Key& key) {
+        const uint64_t h = hasher_(key);
+        const size_t i = h % shards_.size();
+        std::string& probe = scratch();
+        probe.clear();
+        kc_.encode(probe, key);
+        std::scoped_lock l(locks_[i]);
+        Shard& s = *shards_[i];
+        SlabItem* it = find(s, h, probe);
+        if (!it) return false;
+        PCACHE_PROBE4(evict, 4, i, h, 2);
+        remove(s, it);
+        counters_[i].size.set(s.index.size());
+        return true;
+    }
+
+    bool contains(const Key& key) {
+        const uint64_t h = hasher_(key);
+        const size_t i = h % shards_.size();
+        std::string& probe = scratch();
+        probe.clear();
+        kc_.encode(probe, key);
+        std::scoped_lock l(locks_[i]);
+        return find(*shards_[i], h, probe) != nullptr;
+    }
+
+    size_t size() {
+        size_t n = 0;
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            std::scoped_lock l(locks_[i]);
+            n += shards_[i]->index.size();
+        }
+        return n;
+    }
+
+    size_t num_shards() const { return shards_.size(); }
+    size_t capacity_bytes() const { return capacity_; }
+
+    // Counters plus the memory picture, which takes each shard lock briefly.
+    Stats stats() {
+        Stats st;
+        st.capacity_bytes = capacity_;
+        st.shards = counters();
+        for (const auto& c : st.shards) st.totals += c;
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            std::scoped_lock l(locks_[i]);
+            const Shard& s = *shards_[i];
+            st.reserved_bytes += s.slab.reserved_bytes();
+            for (size_t c = 0; c < s.slab.num_classes(); ++c)
+                st.used_bytes += s.slab.used_chunks(int(c)) * s.slab.chunk_bytes(int(c));
+            st.item_bytes += s.item_bytes;
+            st.index_bytes += s.index.memory_bytes();
+        }
+        return st;
+    }
+
+    std::vector<CounterSnapshot> counters() const {
+        std::vector<CounterSnapshot> out;
+        out.reserve(counters_.size());
+        for (const auto& c : counters_) out.push_back(CounterSnapshot::of(c));
+        return out;
+    }
+
+    // Per-shard lock contention; empty unless built with PCACHE_LOCK_STATS.
+    std::vector<LockStats> lock_stats() { return collect_lock_stats(locks_); }
+    void reset_lock_stats() { clear_lock_stats(locks_); }
+
+private:
+    // Open-addressing (linear probing) table of item pointers keyed by
+    // SlabItem::hash; one allocation, regrown at 75% load.
+    class Index {
+    public:
+        Index() : slots_(16, nullptr) {}
+
+        template <typename Match>
+        SlabItem* find(uint64_t h, Match&& match) const {
+            for (size_t j = home(h);; j = (j + 1) & mask()) {
+                SlabItem* it = slots_[j];
+                if (!it) return nullptr;
+                if (it->hash == h && match(it)) return it;
+            }
+        }
+
+        // Any entry with hash h (one at most: insert replaces by hash).
+        SlabItem* find(uint64_t h) const {
+            return find(h, [](const SlabItem*) { return true; });
+        }
+
+        void insert(SlabItem* it) {
+            if ((n_ + 1) * 4 > slots_.size() * 3) grow();
+            size_t j = home(it->hash);
+            while (slots_[j]) j = (j + 1) & mask();
+            slots_[j] = it;
+            ++n_;
+        }
+
+        // Backward-shift deletion: no tombstones, so probes stay short.
+        void erase(const SlabItem* it) {
+            size_t i = home(it->hash);
+            while (slots_[i] != it) i = (i + 1) & mask();
+            for (size_t j = (i + 1) & mask(); slots_[j]; j = (j + 1) & mask()) {
+                const size_t k = home(slots_[j]->hash);
+                // move slots_[j] into the hole at i unless its home lies cyclically in (i, j]
+                if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+                    slots_[i] = slots_[j];
+                    i = j;
+                }
+            }
+            slots_[i] = nullptr;
+            --n_;
+        }
+
+        size_t size() const { return n_; }
+        size_t memory_bytes() const { return slots_.size() * sizeof(SlabItem*); }
+
+    private:
+        size_t mask() const { return slots_.size() - 1; }
+        size_t home(uint64_t h) const { return size_t(mix64(h)) & mask(); }
+
+        void grow() {
+            std::vector<SlabItem*> old(slots_.size() * 2, nullptr);
+            old.swap(slots_);
+            n_ = 0;
+            for (SlabItem* it : old)
+                if (it) insert(it);
+        }
+
+        std::vector<SlabItem*> slots_;
+        size_t n_ = 0;
+    };
+
+    struct Shard {
+        Shard(size_t budget, size_t page) : slab(budget, page), lru(slab.num_classes()) {}
+
+        SlabAllocator slab;
+        SlabLru lru;
+        Index index;
+        uint64_t item_bytes = 0;
+    };
+
+    // Reused encoding buffer, so lookups of encoded keys do not allocate.
+    static std::string& scratch() {
+        static thread_local std::string buf;
+        return buf;
+    }
+
+    // Takes scratch()'s buffer for the lifetime of an insert and gives it back
+    // after. An on_evict that re-enters a cache on this thread (a TieredCache
+    // spilling into another slab cache) finds scratch() empty instead of
+    // overwriting the record being inserted.
+    struct ScratchLease {
+        std::string buf;
+        ScratchLease() : buf(std::move(scratch())) { buf.clear(); }
+        ~ScratchLease() { scratch() = std::move(buf); }
+    };
+
+    SlabItem* find(const Shard& s, uint64_t h, const std::string& key_bytes) const {
+        return s.index.find(h, [&](const SlabItem* it) {
+            return it->size >= key_bytes.size() && std::memcmp(it->data(), key_bytes.data(), key_bytes.size()) == 0;
+        });
+    }
+
+    template <bool kDecode, typename OnEvict>
+    PutOutcome insert(const Key& key, const Value& value, OnEvict&& on_evict) {
+        const uint64_t h = hasher_(key);
+        const size_t i = h % shards_.size();
+        ScratchLease lease;
+        std::string& rec = lease.buf;
+        kc_.encode(rec, key);
+        const size_t key_len = rec.size();
+        vc_.encode(rec, value);
+        std::scoped_lock l(locks_[i]);
+        Shard& s = *shards_[i];
+        ShardCounters& c = counters_[i];
+        c.puts.add();
+        auto evict = [&](SlabItem* it) {
+            c.evictions.add();
+            PCACHE_PROBE4(evict, 4, i, it->hash, 0);
+            if constexpr (kDecode) {
+                SnapshotReader in(it->data(), it->size);
+                Key k = kc_.decode(in);
+                Value v = vc_.decode(in);
+                on_evict(k, v);
+            }
+        };
+        const size_t bytes = sizeof(SlabItem) + rec.size();
+        const int cls = s.slab.class_for(bytes);
+        if (SlabItem* old = s.index.find(h)) {
+            const bool same_key = old->size >= key_len && std::memcmp(old->data(), rec.data(), key_len) == 0;
+            if (same_key && old->cls == cls) {   // update in place
+                s.item_bytes = s.item_bytes - old->size + rec.size();
+                old->size = uint32_t(rec.size());
+                std::memcpy(old->data(), rec.data(), rec.size());
+                s.lru.touch(old);
+                PCACHE_PROBE4(put, 4, i, h, 0);
+                return PutOutcome::kUpdated;
+            }
+            if (!same_key) evict(old);   // hash collision: the new key replaces it
+            remove(s, old);
+        }
+        auto reject = [&] {
+            c.rejected.add();
+            PCACHE_PROBE4(put, 4, i, h, 3);
+            c.size.set(s.index.size());
+            return PutOutcome::kRejected;
+        };
+        if (cls < 0) return reject();
+        char* chunk = nullptr;
+        bool evicted = false;
+        while (!(chunk = s.slab.allocate(cls))) {
+            evicted = true;
+            if (SlabItem* victim = s.lru.tail(cls)) {
+                evict(victim);
+                remove(s, victim);
+                continue;
+            }
+            const int donor = s.slab.donor_class(cls);
+            if (donor < 0) return reject();   // no page anywhere: only with a budget below one page
+            s.slab.move_page(donor, cls, [&](char* p) {
+                SlabItem* it = reinterpret_cast<SlabItem*>(p);
+                evict(it);
+                forget(s, it);
+            });
+        }
+        SlabItem* it = new (chunk) SlabItem{nullptr, nullptr, h, uint32_t(rec.size()), uint16_t(cls), 0};
+        std::memcpy(it->data(), rec.data(), rec.size());
+        s.lru.push_front(it);
+        s.index.insert(it);
+        s.item_bytes += bytes;
+        c.size.set(s.index.size());
+        PCACHE_PROBE4(put, 4, i, h, evicted ? 2 : 1);
+        return evicted ? PutOutcome::kEvicted : PutOutcome::kInserted;
+    }
+
+    // Unlinks an entry and frees its chunk.
+    void remove(Shard& s, SlabItem* it) {
+        forget(s, it);
+        s.slab.deallocate(it->cls, reinterpret_cast<char*>(it));
+    }
+
+    // Unlinks an entry; its chunk is the caller's.
+    void forget(Shard& s, SlabItem* it) {
+        s.lru.unlink(it);
+        s.index.erase(it);
+        s.item_bytes -= sizeof(SlabItem) + it->size;
+    }
+
+    std::vector<ShardMutex> locks_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::vector<ShardCounters> counters_;
+    KeyCodec kc_;
+    ValueCodec vc_;
+    std::hash<Key> hasher_;
+    size_t capacity_;
+};
@@ -4,51 +4,464 @@
 #include <mutex>
 #include <optional>
 #include <functional>
+#include <unordered_set>
+#include <string>
 #include "TinyLFUAdmittingLRU.hpp"
+#include "ShadowCache.hpp"
+#include "KeyHash.hpp"
+#include "InstrumentedMutex.hpp"
+#include "CacheCounters.hpp"
+#include "HeavyHitters.hpp"
+#include "HyperLogLog.hpp"
+#include "Snapshot.hpp"
+#include "CheckpointLog.hpp"
+#include "Probes.hpp"
 
 template <typename Key, typename Value>
 class ShardedWTinyLFU {
 public:
+    struct Stats {
+        size_t size = 0;
+        size_t capacity = 0;
+        std::vector<ShadowEstimate> shadow; // empty unless enable_shadow_caches() was called
+        CounterSnapshot totals;             // sum over shards; all zero with PCACHE_DISABLE_STATS
+        std::vector<CounterSnapshot> shards;
+        std::vector<HotKey<Key>> hot_keys;  // hottest keys over all shards, see hot_keys()
+        CardinalityEstimate distinct;       // see distinct_keys()
+    };
+
+    using PutOutcome = typename TinyLFUAdmittingLRU<Key, Value>::PutOutcome;
+
     ShardedWTinyLFU(size_t capacity, size_t shards,
                     size_t cms_width = 4096, size_t cms_depth = 4)
-        : locks_(shards), shards_(shards)
+        : locks_(shards), shards_(shards), gets_(shards, 0), counters_(shards), prefetched_(shards), hot_(shards),
+          distinct_(kStatsEnabled ? shards : 0, WindowedHyperLogLog(PCACHE_HLL_WINDOWS, PCACHE_HLL_PRECISION)),
+          capacity_(capacity),
+          cms_width_(cms_width), cms_depth_(cms_depth)
     {
         if (shards == 0) throw std::invalid_argument("shards must be > 0");
-        const size_t base  = capacity / shards;
-        const size_t extra = capacity % shards;
+        for (size_t i = 0; i < shards; ++i) shards_[i] = make_shard(i);
+    }
 
-        for (size_t i = 0; i < shards; ++i) {
-            const size_t cap = base + (i == shards - 1 ? extra : 0);
-            shards_[i] = std::make_unique<TinyLFUAdmittingLRU<Key, Value>>(cap, cms_width, cms_depth);
-        }
+    // Track what the hit rate would be at factor * capacity for each factor, using a
+    // hash-sampled fraction of the keys. Call before the cache is shared between threads.
+    void enable_shadow_caches(const std::vector<double>& factors = {0.5, 1.0, 2.0, 4.0},
+                              double sample_rate = 0.03) {
+        shadow_ = std::make_unique<ShadowCacheSet>(capacity_, factors, sample_rate,
+                                                   cms_width_ * shards_.size(), cms_depth_, shards_.size());
     }
 
     std::optional<Value> get(const Key& key) {
-        const size_t i = idx(key);
-        std::scoped_lock l(locks_[i]);
-        return shards_[i]->get(key);
+        NullStageTimer t;
+        return get(key, t);
     }
 
-    void put(const Key& key, const Value& value) {
-        const size_t i = idx(key);
-        std::scoped_lock l(locks_[i]);
-        shards_[i]->put(key, value);
+    // get() with stage marks for PredictiveShardedCache's stage timing
+    template <typename Timer>
+    std::optional<Value> get(const Key& key, Timer& t) {
+        return lookup(key, t, /*counted=*/true);
+    }
+
+    // Same effect on recency, frequency and shadows as get(), but not counted as
+    // a hit or miss: for the cache's own probes, e.g. checking prefetch candidates.
+    bool touch(const Key& key) {
+        NullStageTimer t;
+        return lookup(key, t, /*counted=*/false).has_value();
+    }
+
+    PutOutcome put(const Key& key, const Value& value) {
+        return put(key, value, [](Key&, Value&) {});
+    }
+
+    // put() that hands an evicted entry to on_evict(Key&, Value&), called under the shard lock.
+    template <typename OnEvict>
+    PutOutcome put(const Key& key, const Value& value, OnEvict&& on_evict) {
+        return insert(key, value, on_evict, /*prefetched=*/false);
+    }
+
+    // put() of a speculatively loaded entry. Counted as prefetch_used if a get()
+    // hits it, or prefetch_wasted if it is refused or evicted first.
+    PutOutcome put_prefetched(const Key& key, const Value& value) {
+        return insert(key, value, [](Key&, Value&) {}, /*prefetched=*/true);
+    }
+
+    // put_prefetched() that hands an evicted entry to on_evict, as put() does.
+    template <typename OnEvict>
+    PutOutcome put_prefetched(const Key& key, const Value& value, OnEvict&& on_evict) {
+        return insert(key, value, on_evict, /*prefetched=*/true);
     }
 
     bool erase(const Key& key) {
-        const size_t i = idx(key);
+        const size_t h = hasher_(key);
+        const size_t i = h % shards_.size();
+        if (shadow_) shadow_->on_erase(i, mix64(h));
         std::scoped_lock l(locks_[i]);
-        return shards_[i]->erase(key);
+        const bool erased = shards_[i]->erase(key);
+        if (erased) PCACHE_PROBE4(evict, 2, i, h, 2);
+        if (erased && log_) log_->append_erase(i, key);
+        if constexpr (kStatsEnabled) prefetched_[i].erase(key);
+        counters_[i].size.set(shards_[i]->size());
+        return erased;
+    }
+
+    // Halve every shard's frequency sketch so admission follows drift; call occasionally.
+    void decay() {
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            std::scoped_lock l(locks_[i]);
+            shards_[i]->decay();
+            counters_[i].decay_runs.add();
+        }
+    }
+
+    size_t size() {
+        size_t s = 0;
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            std::scoped_lock l(locks_[i]);
+            s += shards_[i]->size();
+        }
+        return s;
+    }
+
+    Stats stats() {
+        Stats st;
+        st.size = size();
+        st.capacity = capacity_;
+        if (shadow_) {
+            uint64_t gets = 0;
+            for (size_t i = 0; i < shards_.size(); ++i) {
+                std::scoped_lock l(locks_[i]);
+                gets += gets_[i];
+            }
+            st.shadow = shadow_->estimates(gets);
+        }
+        st.shards = counters();
+        for (const auto& c : st.shards) st.totals += c;
+        st.hot_keys = hot_keys();
+        st.distinct = distinct_keys();
+        return st;
+    }
+
+    // The k most frequently read keys over all shards with estimated get counts,
+    // from a sample of gets (HeavyHitters.hpp). touch() is not counted. Empty with
+    // PCACHE_DISABLE_STATS.
+    std::vector<HotKey<Key>> hot_keys(size_t k = 10) {
+        std::vector<HotKey<Key>> out;
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            std::scoped_lock l(locks_[i]);
+            hot_.collect(i, out);
+        }
+        ShardedHotKeys<Key>::rank(out, k);
+        return out;
+    }
+
+    // Distinct keys read per window and the capacity and cms_width they
+    // suggest (HyperLogLog.hpp). Empty with PCACHE_DISABLE_STATS.
+    CardinalityEstimate distinct_keys() {
+        std::vector<WindowedHyperLogLog> copies;
+        copies.reserve(distinct_.size());
+        for (size_t i = 0; i < distinct_.size(); ++i) {
+            std::scoped_lock l(locks_[i]);
+            copies.push_back(distinct_[i]);
+        }
+        return estimate_cardinality(copies, capacity_);
+    }
+
+    // Starts a new distinct-key window and drops the oldest of PCACHE_HLL_WINDOWS.
+    // Call on a timer, ideally next to decay(): suggested_cms_width assumes one
+    // sketch decay per window.
+    void rotate_distinct_window() {
+        for (size_t i = 0; i < distinct_.size(); ++i) {
+            std::scoped_lock l(locks_[i]);
+            distinct_[i].rotate();
+        }
+    }
+
+    // Per-shard counters alone; reads atomics only, takes no locks.
+    std::vector<CounterSnapshot> counters() const {
+        std::vector<CounterSnapshot> out;
+        out.reserve(counters_.size());
+        for (const auto& c : counters_) out.push_back(CounterSnapshot::of(c));
+        return out;
     }
 
     size_t num_shards() const { return shards_.size(); }
 
+    // Writes every shard's entries, least recently used first, and its TinyLFU
+    // sketch to a snapshot file (Snapshot.hpp). Shards are encoded and written in
+    // parallel; each shard is locked while it is encoded. Keys and values go
+    // through the codecs, SnapshotCodec by default. Throws std::runtime_error on
+    // I/O errors.
+    template <typename KeyCodec = SnapshotCodec<Key>, typename ValueCodec = SnapshotCodec<Value>>
+    void save(const std::string& path, const KeyCodec& kc = KeyCodec{}, const ValueCodec& vc = ValueCodec{}) {
+        SnapshotWriter w(snapshot_geometry());
+        add_snapshot_sections(w, kc, vc);
+        w.write(path);
+    }
+
+    // Replaces the cache contents with a snapshot written by save(). The file is
+    // memory-mapped and the shards are rebuilt in parallel, then swapped in. With
+    // the same shard count each shard keeps its recency order, and with the same
+    // sketch geometry too its frequency counts; otherwise entries are re-routed,
+    // recency is kept only within each saved shard and the sketches start empty.
+    // Entries beyond the capacity are dropped least recently used first. Counters
+    // keep running. With the checkpoint log enabled, ends with a checkpoint(), so
+    // recovery restores the loaded contents. Throws std::runtime_error on a
+    // missing, malformed or corrupt file.
+    template <typename KeyCodec = SnapshotCodec<Key>, typename ValueCodec = SnapshotCodec<Value>>
+    void load(const std::string& path, const KeyCodec& kc = KeyCodec{}, const ValueCodec& vc = ValueCodec{}) {
+        SnapshotFile f(path);
+        restore_snapshot(f, kc, vc);
+    }
+
+    // Building blocks of save() and load(), shared with PredictiveShardedCache.
+    SnapshotGeometry snapshot_geometry() const {
+        return SnapshotGeometry{shards_.size(), capacity_, cms_width_, cms_depth_};
+    }
+
+    template <typename KeyCodec, typename ValueCodec>
+    void add_snapshot_sections(SnapshotWriter& w, const KeyCodec& kc, const ValueCodec& vc) {
+        const size_t n = shards_.size();
+        std::vector<std::string> entries(n), sketches(n);
+        std::vector<uint64_t> counts(n), log_pos(n);
+        snapshot_detail::parallel_for(n, [&](size_t i) {
+            std::scoped_lock l(locks_[i]);
+            std::string& out = entries[i];
+            shards_[i]->for_each_lru_first([&](const Key& k, const Value& v) {
+                kc.encode(out, k);
+                vc.encode(out, v);
+            });
+            counts[i] = shards_[i]->size();
+            if (log_) log_pos[i] = log_->position(i);
+            const CountMinSketch& cms = shards_[i]->sketch();
+            for (size_t r = 0; r < cms.depth(); ++r)
+                sketches[i].append(reinterpret_cast<const char*>(cms.row(r).data()), cms.row(r).size() * sizeof(uint32_t));
+        });
+        for (size_t i = 0; i < n; ++i) {
+            w.add(SnapshotSection::kEntries, i, counts[i], std::move(entries[i]));
+            w.add(SnapshotSection::kSketch, i, cms_depth_, std::move(sketches[i]));
+            if (log_) {
+                std::string pos;
+                snapshot_detail::append_pod(pos, log_pos[i]);
+                w.add(SnapshotSection::kLogPosition, i, 1, std::move(pos));
+            }
+        }
+    }
+
+    template <typename KeyCodec, typename ValueCodec>
+    void restore_snapshot(const SnapshotFile& f, const KeyCodec& kc, const ValueCodec& vc) {
+        const size_t n = shards_.size();
+        const SnapshotGeometry& g = f.geometry();
+        const bool same_shards = g.shards == n;
+        std::vector<std::unique_ptr<TinyLFUAdmittingLRU<Key, Value>>> fresh(n);
+        for (size_t i = 0; i < n; ++i) fresh[i] = make_shard(i);
+
+        const auto entries = f.sections(SnapshotSection::kEntries);
+        std::vector<std::mutex> route_mu(same_shards ? 0 : n);   // re-routed entries only
+        snapshot_detail::parallel_for(entries.size(), [&](size_t s) {
+            const auto& sec = *entries[s];
+            SnapshotReader in = SnapshotFile::open(sec);
+            if (same_shards) {
+                auto& shard = *fresh[sec.shard];
+                shard.reserve(size_t(std::min<uint64_t>(sec.items, shard.capacity())));
+                for (uint64_t e = 0; e < sec.items; ++e) {
+                    const Key k = kc.decode(in);
+                    shard.restore(k, vc.decode(in));
+                }
+            } else {
+                for (uint64_t e = 0; e < sec.items; ++e) {
+                    const Key k = kc.decode(in);
+                    const Value v = vc.decode(in);
+                    const size_t i = hasher_(k) % n;
+                    std::scoped_lock l(route_mu[i]);
+                    fresh[i]->restore(k, v);
+                }
+            }
+        });
+        if (same_shards && g.cms_width == cms_width_ && g.cms_depth == cms_depth_) {
+            const auto sketches = f.sections(SnapshotSection::kSketch);
+            snapshot_detail::parallel_for(sketches.size(), [&](size_t s) {
+                SnapshotReader in = SnapshotFile::open(*sketches[s]);
+                CountMinSketch& cms = fresh[sketches[s]->shard]->sketch();
+                for (size_t r = 0; r < cms.depth(); ++r)
+                    in.read(cms.row(r).data(), cms.row(r).size() * sizeof(uint32_t));
+            });
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            std::scoped_lock l(locks_[i]);
+            shards_[i].swap(fresh[i]);
+            prefetched_[i].clear();
+            counters_[i].size.set(shards_[i]->size());
+        }
+        // fresh now holds the replaced shards; they are freed on return, outside the locks
+        if (log_) checkpoint();   // the log has no records of the swap; make it the new base
+    }
+
+    // Makes `dir` this cache's checkpoint directory (CheckpointLog.hpp). The cache
+    // is first restored from the snapshot and log tail found there, if any. From
+    // then on every admission, eviction, value update and erase is appended to the
+    // log by a background group-commit writer, and the log is compacted into a new
+    // snapshot every opt.compact_after_bytes. Call once, before the cache is shared
+    // between threads. Throws std::runtime_error if the directory or files cannot
+    // be used.
+    template <typename KeyCodec = SnapshotCodec<Key>, typename ValueCodec = SnapshotCodec<Value>>
+    void enable_checkpoint_log(const std::string& dir, const CheckpointLogOptions& opt = CheckpointLogOptions{},
+                               const KeyCodec& kc = KeyCodec{}, const ValueCodec& vc = ValueCodec{}) {
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        if (ec) throw std::runtime_error("checkpoint log: cannot create " + dir);
+        bool reshard = false;
+        std::vector<uint64_t> next = recover(dir, kc, vc, reshard);
+        checkpoint_path_ = dir + "/snapshot";
+        save_checkpoint_ = [this, kc, vc] { save(checkpoint_path_, kc, vc); };
+        log_ = std::make_unique<CheckpointLog<Key, Value>>(
+            dir, shards_.size(), std::move(next), [kc](std::string& out, const Key& k) { kc.encode(out, k); },
+            [vc](std::string& out, const Value& v) { vc.encode(out, v); }, opt, [this] { checkpoint(/*wait=*/false); });
+        // LSNs are per shard, so a log written with another shard count must not outlive this start
+        if (reshard) checkpoint();
+    }
+
+    // Compaction: writes a new snapshot to the checkpoint directory and deletes the
+    // log segments it covers. Runs concurrently with gets and puts; each shard is
+    // locked only while it is encoded. With wait = false, returns at once if a
+    // checkpoint is already running.
+    void checkpoint(bool wait = true) {
+        if (!log_) throw std::runtime_error("checkpoint log not enabled");
+        std::unique_lock c(checkpoint_mu_, std::defer_lock);
+        if (wait) c.lock();
+        else if (!c.try_lock()) return;
+        const uint64_t gen = log_->rotate();
+        save_checkpoint_();
+        log_->drop_segments_before(gen);
+    }
+
+    // Blocks until every change logged so far is on disk.
+    void flush_checkpoint_log() {
+        if (log_) log_->flush();
+    }
+
+    // Default-constructed (generation 0) unless the checkpoint log is enabled.
+    typename CheckpointLog<Key, Value>::Stats checkpoint_log_stats() const {
+        return log_ ? log_->stats() : typename CheckpointLog<Key, Value>::Stats{};
+    }
+
+    // Per-shard lock contention; empty unless built with PCACHE_LOCK_STATS.
+    std::vector<LockStats> lock_stats() { return collect_lock_stats(locks_); }
+    void reset_lock_stats() { clear_lock_stats(locks_); }
+
 private:
-    size_t idx(const Key& key) const {
-        return hasher_(key) % shards_.size();
+    // Restores the snapshot and log tail in dir; returns the next LSN per logged shard.
+    // reshard is set when they were written with a different shard count.
+    template <typename KeyCodec, typename ValueCodec>
+    std::vector<uint64_t> recover(const std::string& dir, const KeyCodec& kc, const ValueCodec& vc, bool& reshard) {
+        using Log = CheckpointLog<Key, Value>;
+        std::vector<uint64_t> covered;   // per logged shard: last LSN the snapshot includes
+        std::error_code ec;
+        if (std::filesystem::exists(dir + "/snapshot", ec)) {
+            SnapshotFile f(dir + "/snapshot");
+            restore_snapshot(f, kc, vc);
+            covered.assign(f.geometry().shards, 0);
+            for (const auto* s : f.sections(SnapshotSection::kLogPosition)) {
+                SnapshotReader in = SnapshotFile::open(*s);
+                covered[s->shard] = in.pod<uint64_t>();
+            }
+            reshard = f.geometry().shards != shards_.size();
+        }
+        std::vector<uint64_t> next(covered.size());
+        for (size_t s = 0; s < covered.size(); ++s) next[s] = covered[s] + 1;
+        Log::replay(dir, [&](size_t shard, uint64_t lsn, typename Log::Op op, SnapshotReader& in) {
+            if (shard >= next.size()) next.resize(shard + 1, 1);
+            next[shard] = std::max(next[shard], lsn + 1);
+            reshard = reshard || shard >= shards_.size();
+            if (shard < covered.size() && lsn <= covered[shard]) return;
+            const Key k = kc.decode(in);
+            const size_t i = hasher_(k) % shards_.size();
+            std::scoped_lock l(locks_[i]);
+            if (op == Log::kPut) shards_[i]->restore(k, vc.decode(in));
+            else shards_[i]->erase(k);
+            counters_[i].size.set(shards_[i]->size());
+        });
+        return next;
+    }
+
+    std::unique_ptr<TinyLFUAdmittingLRU<Key, Value>> make_shard(size_t i) const {
+        const size_t n = shards_.size();
+        const size_t cap = capacity_ / n + (i == n - 1 ? capacity_ % n : 0);
+        return std::make_unique<TinyLFUAdmittingLRU<Key, Value>>(cap, cms_width_, cms_depth_);
+    }
+
+    template <typename Timer>
+    std::optional<Value> lookup(const Key& key, Timer& t, bool counted) {
+        const size_t h = hasher_(key);
+        const size_t i = h % shards_.size();
+        if (shadow_) shadow_->on_get(i, mix64(h));
+        std::scoped_lock l(locks_[i]);
+        ++gets_[i];
+        auto v = shards_[i]->get(key, t);
+        if (counted) {
+            ShardCounters& c = counters_[i];
+            (v ? c.hits : c.misses).add();
+            hot_.on_get(i, key);
+            if constexpr (kStatsEnabled) distinct_[i].add(mix64(h));
+            if constexpr (kStatsEnabled) {
+                if (v && !prefetched_[i].empty() && prefetched_[i].erase(key)) c.prefetch_used.add();
+            }
+            PCACHE_PROBE4(get, 2, i, h, v.has_value());
+        }
+        return v;
+    }
+
+    template <typename OnEvict>
+    PutOutcome insert(const Key& key, const Value& value, OnEvict&& on_evict, bool prefetched) {
+        const size_t h = hasher_(key);
+        const size_t i = h % shards_.size();
+        if (shadow_) shadow_->on_put(i, mix64(h));
+        std::scoped_lock l(locks_[i]);
+        ShardCounters& c = counters_[i];
+        const PutOutcome r = shards_[i]->put(key, value, [&](Key& k, Value& v) {
+            c.evictions.add();
+            [[maybe_unused]] int reason = 0;
+            if constexpr (kStatsEnabled) {
+                if (!prefetched_[i].empty() && prefetched_[i].erase(k)) {
+                    c.prefetch_wasted.add();
+                    reason = 1;
+                }
+            }
+            PCACHE_PROBE4(evict, 2, i, hasher_(k), reason);
+            if (log_) log_->append_erase(i, k);
+            on_evict(k, v);
+        });
+        c.puts.add();
+        PCACHE_PROBE4(put, 2, i, h, int(r));
+        if (log_ && r != PutOutcome::kRejected) log_->append_put(i, key, value);
+        if (r == PutOutcome::kAdmitted) c.admitted.add();
+        else if (r == PutOutcome::kRejected) c.rejected.add();
+        if constexpr (kStatsEnabled) {
+            // a prefetch of a key already present, or an ordinary put over a
+            // prefetched entry, leaves nothing speculative to account for
+            if (!prefetched) { if (!prefetched_[i].empty()) prefetched_[i].erase(key); }
+            else if (r == PutOutcome::kRejected) c.prefetch_wasted.add();
+            else if (r != PutOutcome::kUpdated) prefetched_[i].insert(key);
+        }
+        c.size.set(shards_[i]->size());
+        return r;
     }
 
-    std::vector<std::mutex> locks_;
+    std::vector<ShardMutex> locks_;
     std::vector<std::unique_ptr<TinyLFUAdmittingLRU<Key, Value>>> shards_;
+    std::vector<uint64_t> gets_; // per shard, guarded by locks_[i]
+    std::vector<ShardCounters> counters_; // written under locks_[i]
+    // per shard, guarded by locks_[i]: resident entries from put_prefetched() not yet hit
+    std::vector<std::unordered_set<Key>> prefetched_;
+    ShardedHotKeys<Key> hot_;   // shard i guarded by locks_[i]
+    std::vector<WindowedHyperLogLog> distinct_; // guarded by locks_[i]; empty with PCACHE_DISABLE_STATS
     std::hash<Key> hasher_;
+    size_t capacity_;
+    size_t cms_width_, cms_depth_;
+    std::unique_ptr<ShadowCacheSet> shadow_;
+    std::mutex checkpoint_mu_;                  // one checkpoint at a time
+    std::string checkpoint_path_;
+    std::function<void()> save_checkpoint_;     // save() to checkpoint_path_ with the log's codecs
+    // last member: its writer thread may run checkpoint(), so it stops before the rest is destroyed
+    std::unique_ptr<CheckpointLog<Key, Value>> log_;
 };
@@ -0,0 +1,197 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+// Size-class allocator in the style of memcached's slabs. Memory comes in
+// fixed-size pages, up to a byte budget. Each page belongs to one size class
+// and is carved into equal chunks; chunk sizes grow geometrically (by `growth`)
+// from min_chunk up to the page size. A freed chunk goes back on its class's
+// free list and is only ever reused by that class, so the heap never
+// fragments: resident memory is the pages, at most the budget. The price is
+// internal waste, at most growth - 1 of a chunk.
+//
+// Not thread-safe: each cache shard owns its allocator and uses it under its
+// lock. Chunks are 8-byte aligned.
+class SlabAllocator {
+public:
+    SlabAllocator(size_t budget_bytes, size_t page_bytes = size_t(1) << 20, size_t min_chunk = 64,
+                  double growth = 1.25)
+        : budget_(budget_bytes), page_bytes_(page_bytes) {
+        if (min_chunk < sizeof(void*) || min_chunk > page_bytes) throw std::invalid_argument("min_chunk out of range");
+        if (growth <= 1.0) throw std::invalid_argument("growth must be > 1");
+        for (double sz = double(min_chunk);;) {
+            const size_t chunk = std::min((size_t(sz) + 7) & ~size_t(7), page_bytes);
+            if (classes_.empty() || chunk > classes_.back().chunk) classes_.push_back(Class{chunk, {}, nullptr, 0});
+            if (chunk == page_bytes) break;
+            sz *= growth;
+        }
+    }
+
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+    SlabAllocator(SlabAllocator&&) = default;
+    SlabAllocator& operator=(SlabAllocator&&) = default;
+
+    size_t num_classes() const { return classes_.size(); }
+    size_t chunk_bytes(int c) const { return classes_[size_t(c)].chunk; }
+    size_t page_bytes() const { return page_bytes_; }
+    size_t budget_bytes() const { return budget_; }
+    size_t reserved_bytes() const { return pages_ * page_bytes_; }   // pages taken from the heap
+    size_t pages(int c) const { return classes_[size_t(c)].pages.size(); }
+    size_t used_chunks(int c) const { return classes_[size_t(c)].used; }
+
+    // Smallest class whose chunks hold `bytes`; -1 if larger than a page.
+    int class_for(size_t bytes) const {
+        size_t lo = 0, hi = classes_.size();
+        while (lo < hi) {
+            const size_t mid = (lo + hi) / 2;
+            if (classes_[mid].chunk < bytes) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo == classes_.size() ? -1 : int(lo);
+    }
+
+    // A chunk of class c: a free one, else one of a new page if the budget
+    // allows. nullptr if neither; the caller then evicts within the class or
+    // moves a page over with move_page().
+    char* allocate(int c) {
+        Class& cl = classes_[size_t(c)];
+        if (!cl.free && (pages_ + 1) * page_bytes_ <= budget_) {
+            cl.pages.emplace_back(new char[page_bytes_]);
+            ++pages_;
+            carve(cl, cl.pages.back().get());
+        }
+        if (!cl.free) return nullptr;
+        FreeChunk* f = cl.free;
+        cl.free = f->next;
+        ++cl.used;
+        return reinterpret_cast<char*>(f);
+    }
+
+    void deallocate(int c, char* p) {
+        Class& cl = classes_[size_t(c)];
+        cl.free = new (p) FreeChunk{cl.free};
+        --cl.used;
+    }
+
+    // Class with the most pages other than `except`, to take a page from when
+    // `except` has none and the budget is spent (memcached's slab reassignment);
+    // -1 if there is none.
+    int donor_class(int except) const {
+        int best = -1;
+        for (size_t c = 0; c < classes_.size(); ++c)
+            if (int(c) != except && !classes_[c].pages.empty() &&
+                (best < 0 || classes_[c].pages.size() > classes_[size_t(best)].pages.size()))
+                best = int(c);
+        return best;
+    }
+
+    // Moves the newest page of class `from` to class `to`. Every chunk of it
+    // still in use is passed to evict(char*) first; the owner must forget those
+    // entries without deallocating them. O(chunks in the page + free chunks of `from`).
+    template <typename Evict>
+    void move_page(int from, int to, Evict&& evict) {
+        Class& src = classes_[size_t(from)];
+        if (src.pages.empty()) return;
+        std::unique_ptr<char[]> page = std::move(src.pages.back());
+        src.pages.pop_back();
+        const size_t n = page_bytes_ / src.chunk;
+        char* const base = page.get();
+        std::vector<bool> is_free(n);
+        FreeChunk** link = &src.free;   // unlink this page's free chunks, keep the rest
+        while (*link) {
+            char* p = reinterpret_cast<char*>(*link);
+            if (p >= base && p < base + page_bytes_) {
+                is_free[size_t(p - base) / src.chunk] = true;
+                *link = (*link)->next;
+            } else {
+                link = &(*link)->next;
+            }
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (is_free[i]) continue;
+            evict(base + i * src.chunk);
+            --src.used;
+        }
+        Class& dst = classes_[size_t(to)];
+        dst.pages.push_back(std::move(page));
+        carve(dst, base);
+    }
+
+private:
+    struct FreeChunk {
+        FreeChunk* next;
+    };
+
+    struct Class {
+        size_t chunk;
+        std::vector<std::unique_ptr<char[]>> pages;
+        FreeChunk* free = nullptr;
+        size_t used = 0;
+    };
+
+    void carve(Class& cl, char* page) {
+        const size_t n = page_bytes_ / cl.chunk;
+        for (size_t i = n; i-- > 0;) cl.free = new (page + i * cl.chunk) FreeChunk{cl.free};
+    }
+
+    size_t budget_, page_bytes_;
+    size_t pages_ = 0;
+    std::vector<Class> classes_;
+};
+
+// Header of an entry stored in a slab chunk, followed by its payload. Entries
+// of one class form an LRU list through prev/next (SlabLru), so eviction
+// within a size class needs no memory outside the chunks.
+struct SlabItem {
+    SlabItem* prev;
+    SlabItem* next;
+    uint64_t hash;     // the owner's index key, to find the entry from its chunk
+    uint32_t size;     // payload bytes
+    uint16_t cls;      // size class of the chunk
+    uint16_t flags;    // owner-defined
+
+    char* data() { return reinterpret_cast<char*>(this + 1); }
+    const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+};
+
+// One intrusive LRU list of SlabItems per size class; most recently used first.
+class SlabLru {
+public:
+    explicit SlabLru(size_t classes) : lists_(classes) {}
+
+    void push_front(SlabItem* it) {
+        List& l = lists_[it->cls];
+        it->prev = nullptr;
+        it->next = l.head;
+        if (l.head) l.head->prev = it;
+        else l.tail = it;
+        l.head = it;
+    }
+
+    void unlink(SlabItem* it) {
+        List& l = lists_[it->cls];
+        (it->prev ? it->prev->next : l.head) = it->next;
+        (it->next ? it->next->prev : l.tail) = it->prev;
+    }
+
+    void touch(SlabItem* it) {
+        if (lists_[it->cls].head == it) return;
+        unlink(it);
+        push_front(it);
+    }
+
+    SlabItem* tail(int cls) const { return lists_[size_t(cls)].tail; }
+
+private:
+    struct List {
+        SlabItem* head = nullptr;
+        SlabItem* tail = nullptr;
+    };
+    std::vector<List> lists_;
+};
@@ -0,0 +1,373 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "KeyHash.hpp"
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Binary snapshots of cache contents, written by ShardedWTinyLFU::save and
+// PredictiveShardedCache::save and read back by their load.
+//
+// Layout, all integers in host byte order (a snapshot from a host of the other
+// byte order fails the version check):
+//
+//   "PCACHESN"  u32 version  u32 flags
+//   u64 shards  u64 capacity  u64 cms_width  u64 cms_depth
+//   u64 n       n x { u32 kind, u32 shard, u64 offset, u64 length, u64 items, u64 checksum }
+//   section payloads at their offsets
+//
+// Sections, one per shard and kind:
+//   kEntries    items entries, least recently used first: key, value (codec encoded)
+//   kSketch     cms_depth rows of cms_width u32 TinyLFU counters
+//   kPredictor  items transitions: key prev, key cur, u32 count, u32 total of prev
+//   kLogPosition  u64 last checkpoint log LSN the entries include (CheckpointLog.hpp)
+//
+// Each payload carries a checksum, verified when the section is read.
+enum class SnapshotSection : uint32_t { kEntries = 1, kSketch = 2, kPredictor = 3, kLogPosition = 4 };
+
+struct SnapshotGeometry {
+    uint64_t shards = 0, capacity = 0, cms_width = 0, cms_depth = 0;
+};
+
+// Bounds-checked cursor over one section payload.
+class SnapshotReader {
+public:
+    SnapshotReader(const char* p, size_t n) : p_(p), end_(p + n) {}
+
+    void read(void* out, size_t n) {
+        if (size_t(end_ - p_) < n) throw std::runtime_error("snapshot: truncated section");
+        std::memcpy(out, p_, n);
+        p_ += n;
+    }
+
+    template <typename T>
+    T pod() {
+        T v;
+        read(&v, sizeof(T));
+        return v;
+    }
+
+    // View of the next n bytes, valid while the snapshot file is open.
+    const char* bytes(size_t n) {
+        if (size_t(end_ - p_) < n) throw std::runtime_error("snapshot: truncated section");
+        const char* b = p_;
+        p_ += n;
+        return b;
+    }
+
+    bool done() const { return p_ == end_; }
+
+private:
+    const char* p_;
+    const char* end_;
+};
+
+// How keys and values are written into a snapshot. The defaults cover
+// trivially copyable types (bytes as in memory) and std::string (u32 length,
+// bytes). For anything else pass a codec object with the same two members to
+// save()/load(), or specialize SnapshotCodec.
+template <typename T, typename = void>
+struct SnapshotCodec {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "no default SnapshotCodec for this type; pass a codec to save()/load()");
+    void encode(std::string& out, const T& v) const { out.append(reinterpret_cast<const char*>(&v), sizeof(T)); }
+    T decode(SnapshotReader& in) const { return in.pod<T>(); }
+};
+
+template <>
+struct SnapshotCodec<std::string> {
+    void encode(std::string& out, const std::string& v) const {
+        const uint32_t n = uint32_t(v.size());
+        out.append(reinterpret_cast<const char*>(&n), sizeof(n));
+        out.append(v);
+    }
+    std::string decode(SnapshotReader& in) const {
+        const uint32_t n = in.pod<uint32_t>();
+        return std::string(in.bytes(n), n);
+    }
+};
+
+namespace snapshot_detail {
+
+inline constexpr char kMagic[8] = {'P', 'C', 'A', 'C', 'H', 'E', 'S', 'N'};
+inline constexpr uint32_t kVersion = 1;
+inline constexpr uint32_t kFlagPredictor = 1;
+
+struct SectionEntry {
+    uint32_t kind, shard;
+    uint64_t offset, length, items, checksum;
+};
+
+template <typename T>
+void append_pod(std::string& out, const T& v) { out.append(reinterpret_cast<const char*>(&v), sizeof(T)); }
+
+inline uint64_t checksum(const char* p, size_t n) {
+    uint64_t h = mix64(n);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        h = mix64(h ^ w);
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, p + i, n - i);
+    return mix64(h ^ tail);
+}
+
+// Runs fn(0..n-1) on up to hardware_concurrency threads; rethrows the first exception.
+template <typename Fn>
+void parallel_for(size_t n, Fn&& fn) {
+    const size_t workers = std::min<size_t>(n, std::max(1u, std::thread::hardware_concurrency()));
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex error_mu;
+    auto run = [&] {
+        for (size_t i; (i = next.fetch_add(1)) < n;) {
+            try {
+                fn(i);
+            } catch (...) {
+                std::scoped_lock l(error_mu);
+                if (!error) error = std::current_exception();
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < workers; ++t) pool.emplace_back(run);
+    run();
+    for (auto& th : pool) th.join();
+    if (error) std::rethrow_exception(error);
+}
+
+// fsync of directory dir_path, so that files created, renamed or deleted in it
+// survive a crash; fsync of a file alone does not persist its directory entry.
+// Always true where there is no such call.
+inline bool sync_dir(const std::string& dir_path) {
+#if defined(__unix__) || defined(__APPLE__)
+    const int fd = ::open(dir_path.empty() ? "." : dir_path.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    const bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#else
+    (void)dir_path;
+    return true;
+#endif
+}
+
+inline std::string parent_dir(const std::string& path) {
+    const size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos) return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+} // namespace snapshot_detail
+
+// Collects encoded sections and writes them as one snapshot file. The file is
+// written under a temporary name, renamed into place and its directory synced,
+// so a crash never leaves a partial snapshot at `path` and the rename is durable
+// when write() returns. Throws std::runtime_error on I/O errors.
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const SnapshotGeometry& g) : geometry_(g) {}
+
+    void add(SnapshotSection kind, size_t shard, uint64_t items, std::string payload) {
+        if (kind == SnapshotSection::kPredictor) flags_ |= snapshot_detail::kFlagPredictor;
+        sections_.push_back(Pending{uint32_t(kind), uint32_t(shard), items, std::move(payload)});
+    }
+
+    void write(const std::string& path) const {
+        using namespace snapshot_detail;
+        std::vector<SectionEntry> table(sections_.size());
+        uint64_t offset = sizeof(kMagic) + 2 * sizeof(uint32_t) + sizeof(SnapshotGeometry) + sizeof(uint64_t) +
+                          table.size() * sizeof(SectionEntry);
+        for (size_t s = 0; s < sections_.size(); ++s) {
+            const Pending& p = sections_[s];
+            table[s] = SectionEntry{p.kind, p.shard, offset, p.payload.size(), p.items, 0};
+            offset += p.payload.size();
+        }
+        parallel_for(sections_.size(), [&](size_t s) {
+            table[s].checksum = checksum(sections_[s].payload.data(), sections_[s].payload.size());
+        });
+
+        std::string head(kMagic, sizeof(kMagic));
+        append_pod(head, kVersion);
+        append_pod(head, flags_);
+        append_pod(head, geometry_);
+        append_pod(head, uint64_t(table.size()));
+        for (const auto& e : table) append_pod(head, e);
+
+        const std::string tmp = path + ".tmp";
+#if defined(__unix__) || defined(__APPLE__)
+        const int fd = ::open(tmp.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+        if (fd < 0) throw std::runtime_error("snapshot: cannot create " + tmp);
+        // sections go to disjoint ranges, so they are written concurrently
+        std::atomic<bool> ok{write_at(fd, head.data(), head.size(), 0)};
+        parallel_for(sections_.size(), [&](size_t s) {
+            if (!write_at(fd, sections_[s].payload.data(), sections_[s].payload.size(), table[s].offset)) ok = false;
+        });
+        ok = ::fsync(fd) == 0 && ok;
+        ::close(fd);
+#else
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(head.data(), std::streamsize(head.size()));
+        for (const auto& p : sections_) out.write(p.payload.data(), std::streamsize(p.payload.size()));
+        out.close();
+        const bool ok = bool(out);
+#endif
+        if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("snapshot: cannot write " + path);
+        }
+        // the rename is durable only once the directory is synced
+        if (!sync_dir(parent_dir(path))) throw std::runtime_error("snapshot: cannot sync the directory of " + path);
+    }
+
+private:
+    struct Pending {
+        uint32_t kind, shard;
+        uint64_t items;
+        std::string payload;
+    };
+
+#if defined(__unix__) || defined(__APPLE__)
+    static bool write_at(int fd, const char* p, size_t n, uint64_t off) {
+        while (n > 0) {
+            const ssize_t w = ::pwrite(fd, p, n, off_t(off));
+            if (w <= 0) return false;
+            p += w;
+            n -= size_t(w);
+            off += uint64_t(w);
+        }
+        return true;
+    }
+#endif
+
+    SnapshotGeometry geometry_;
+    uint32_t flags_ = 0;
+    std::vector<Pending> sections_;
+};
+
+// A snapshot file opened for reading: memory-mapped where POSIX mmap is
+// available, read into memory otherwise. The constructor validates the header
+// and section table and throws std::runtime_error on anything malformed.
+class SnapshotFile {
+public:
+    struct Section {
+        SnapshotSection kind;
+        size_t shard;
+        uint64_t items;
+        const char* data;
+        size_t length;
+        uint64_t checksum;
+    };
+
+    explicit SnapshotFile(const std::string& path) {
+        map(path);
+        try {
+            parse(path);
+        } catch (...) {
+            unmap();
+            throw;
+        }
+    }
+
+    ~SnapshotFile() { unmap(); }
+
+    SnapshotFile(const SnapshotFile&) = delete;
+    SnapshotFile& operator=(const SnapshotFile&) = delete;
+
+    const SnapshotGeometry& geometry() const { return geometry_; }
+    bool has_predictor() const { return flags_ & snapshot_detail::kFlagPredictor; }
+
+    std::vector<const Section*> sections(SnapshotSection kind) const {
+        std::vector<const Section*> out;
+        for (const auto& s : sections_)
+            if (s.kind == kind) out.push_back(&s);
+        return out;
+    }
+
+    // Reader over a section's payload; verifies its checksum first.
+    static SnapshotReader open(const Section& s) {
+        if (snapshot_detail::checksum(s.data, s.length) != s.checksum)
+            throw std::runtime_error("snapshot: checksum mismatch in shard " + std::to_string(s.shard));
+        return SnapshotReader(s.data, s.length);
+    }
+
+private:
+    void parse(const std::string& path) {
+        using namespace snapshot_detail;
+        SnapshotReader in(data_, size_);
+        char magic[sizeof(kMagic)];
+        in.read(magic, sizeof(magic));
+        if (std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) throw std::runtime_error("snapshot: bad magic in " + path);
+        if (in.pod<uint32_t>() != kVersion) throw std::runtime_error("snapshot: unsupported version in " + path);
+        flags_ = in.pod<uint32_t>();
+        geometry_ = in.pod<SnapshotGeometry>();
+        const uint64_t n = in.pod<uint64_t>();
+        if (n > size_ / sizeof(SectionEntry)) throw std::runtime_error("snapshot: bad section table in " + path);
+        for (uint64_t s = 0; s < n; ++s) {
+            const auto e = in.pod<SectionEntry>();
+            if (e.offset > size_ || e.length > size_ - e.offset || e.shard >= geometry_.shards)
+                throw std::runtime_error("snapshot: bad section table in " + path);
+            sections_.push_back(Section{SnapshotSection(e.kind), e.shard, e.items, data_ + e.offset, size_t(e.length), e.checksum});
+        }
+    }
+
+    void map(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("snapshot: cannot open " + path);
+        struct stat st {};
+        if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error("snapshot: cannot read " + path);
+        }
+        size_ = size_t(st.st_size);
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) throw std::runtime_error("snapshot: cannot map " + path);
+#if defined(MADV_WILLNEED)
+        ::madvise(p, size_, MADV_WILLNEED);
+#endif
+        data_ = static_cast<const char*>(p);
+#else
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw std::runtime_error("snapshot: cannot open " + path);
+        buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+#endif
+    }
+
+    void unmap() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (data_) ::munmap(const_cast<char*>(data_), size_);
+#endif
+    }
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#if !(defined(__unix__) || defined(__APPLE__))
+    std::vector<char> buffer_;
+#endif
+    uint32_t flags_ = 0;
+    SnapshotGeometry geometry_;
+    std::vector<Section> sections_;
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "CycleClock.hpp"
+#include "LogHistogram.hpp"
+
+// Sampled per-stage timing of PredictiveShardedCache::get, compiled in with
+// -DPCACHE_STAGE_TIMING (CMake option of the same name). Without it nothing
+// below is instantiated and the cache code is unchanged.
+//
+// One get in 2^PCACHE_STAGE_SAMPLE_SHIFT per thread is timed. Time is read from
+// the cycle counter (CycleClock.hpp) and kept in ticks; cycle_clock::ticks_per_ns()
+// converts for reporting.
+#ifndef PCACHE_STAGE_SAMPLE_SHIFT
+#define PCACHE_STAGE_SAMPLE_SHIFT 6
+#endif
+
+enum class GetStage : unsigned {
+    kLock,          // waiting for the predictive shard lock
+    kObserve,       // MarkovPredictor::observe of prev -> key
+    kBaseLookup,    // base cache get: routing, base shard lock, LRU lookup
+    kCmsUpdate,     // TinyLFU frequency sketch increment
+    kTopK,          // MarkovPredictor::topk_next
+    kPrefetch,      // checking candidates and inserting prefetched entries
+    kNumStages
+};
+
+inline const char* stage_name(GetStage s) {
+    static constexpr const char* kNames[] = {"lock", "observe", "base_lookup", "cms_update", "topk", "prefetch"};
+    return kNames[unsigned(s)];
+}
+
+namespace stage_timing {
+
+// True for the calls this thread should time.
+inline bool sample() {
+    thread_local uint32_t n = 0;
+    return (++n & ((uint32_t(1) << PCACHE_STAGE_SAMPLE_SHIFT) - 1)) == 0;
+}
+
+} // namespace stage_timing
+
+using StageHistograms = std::array<LogHistogram, size_t(GetStage::kNumStages)>;
+
+// Accumulates ticks per stage for one call: mark(s) charges the time since the
+// previous mark to s, so a stage split by nested calls is summed. Inactive
+// timers do nothing.
+class StageTimer {
+public:
+    explicit StageTimer(bool active) : active_(active), last_(active ? cycle_clock::ticks() : 0) {}
+
+    void mark(GetStage s) {
+        if (!active_) return;
+        const uint64_t now = cycle_clock::ticks();
+        ticks_[unsigned(s)] += now - last_;
+        last_ = now;
+    }
+
+    bool active() const { return active_; }
+
+    void record_into(StageHistograms& h) const {
+        if (!active_) return;
+        for (size_t s = 0; s < ticks_.size(); ++s) h[s].record(ticks_[s]);
+    }
+
+private:
+    bool active_;
+    uint64_t last_;
+    std::array<uint64_t, size_t(GetStage::kNumStages)> ticks_{};
+};
+
+// Stand-in for the untimed path; every mark folds away.
+struct NullStageTimer {
+    void mark(GetStage) {}
+};
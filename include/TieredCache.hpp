@@ -0,0 +1,155 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "DiskTier.hpp"
+#include "InstrumentedMutex.hpp"
+
+// A DRAM cache (Core: ShardedLRU, ShardedWTinyLFU or PredictiveShardedCache)
+// in front of a larger, slower victim tier (Tier: DiskTier by default):
+//
+//   - Entries the core evicts are written to the tier, from the core's
+//     on_evict callback, so under the core's shard lock. That includes
+//     evictions by PredictiveShardedCache's prefetches, through its
+//     prefetch evict handler; use it with a prefetcher, or its placeholder
+//     values are spilled and served like real ones.
+//   - A put that TinyLFU admission rejects goes to the tier instead; one the
+//     core accepts removes any older copy from the tier.
+//   - A get that misses the core looks in the tier and, on a hit, promotes the
+//     value: puts it back into the core, then removes it from the tier if the
+//     core accepted it. With a TinyLFU core a key keeps being served from the
+//     tier until its frequency wins admission.
+//   - multi_get() batches the tier reads of all core misses (one io_uring
+//     submission for DiskTier).
+//
+// Puts, erases and promotions of a key are serialized by one of kStripes
+// striped locks, taken before the core's and the tier's own. The tier read of
+// a get runs without it; a put or erase of the key during the read cancels
+// the promotion, so an older value is never put back over a newer one.
+template <typename Key, typename Value, typename Core, typename Tier = DiskTier<Key, Value>>
+class TieredCache {
+public:
+    TieredCache(std::unique_ptr<Core> core, std::unique_ptr<Tier> tier) : core_(std::move(core)), tier_(std::move(tier)) {
+        if (!core_ || !tier_) throw std::invalid_argument("core and tier are required");
+        if constexpr (HasPrefetchEvictHandler<Core>::value)
+            core_->set_prefetch_evict_handler([this](Key& k, Value& v) { tier_->put(k, v); });
+    }
+
+    std::optional<Value> get(const Key& key) {
+        if (auto v = core_->get(key)) return v;
+        Stripe& s = stripe(key);
+        const uint64_t seen = version(s);
+        auto v = tier_->get(key);
+        if (v) promote(key, *v, s, seen);
+        return v;
+    }
+
+    // get() of every key; the tier reads of all core misses go out as one batch.
+    std::vector<std::optional<Value>> multi_get(const std::vector<Key>& keys) {
+        std::vector<std::optional<Value>> out(keys.size());
+        std::vector<size_t> missed;
+        std::vector<Key> tier_keys;
+        std::vector<uint64_t> seen;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            out[i] = core_->get(keys[i]);
+            if (out[i]) continue;
+            missed.push_back(i);
+            tier_keys.push_back(keys[i]);
+            seen.push_back(version(stripe(keys[i])));
+        }
+        if (missed.empty()) return out;
+        auto found = tier_->get_batch(tier_keys);
+        for (size_t j = 0; j < missed.size(); ++j) {
+            if (!found[j]) continue;
+            promote(tier_keys[j], *found[j], stripe(tier_keys[j]), seen[j]);
+            out[missed[j]] = std::move(found[j]);
+        }
+        return out;
+    }
+
+    void put(const Key& key, const Value& value) {
+        Stripe& s = stripe(key);
+        std::scoped_lock l(s.mu);
+        ++s.version;
+        if (core_put(key, value)) tier_->erase(key);
+        else tier_->put(key, value);
+    }
+
+    bool erase(const Key& key) {
+        Stripe& s = stripe(key);
+        std::scoped_lock l(s.mu);
+        ++s.version;
+        const bool in_core = core_->erase(key);
+        const bool in_tier = tier_->erase(key);
+        return in_core || in_tier;
+    }
+
+    size_t size() { return core_->size() + tier_->size(); }
+
+    // Tier hits put back into the core.
+    uint64_t promotions() {
+        uint64_t n = 0;
+        for (auto& s : stripes_) {
+            std::scoped_lock l(s.mu);
+            n += s.promotions;
+        }
+        return n;
+    }
+
+    Core& core() { return *core_; }
+    Tier& tier() { return *tier_; }
+
+private:
+    static constexpr size_t kStripes = 256;
+
+    template <typename C, typename = void>
+    struct HasPrefetchEvictHandler : std::false_type {};
+    template <typename C>
+    struct HasPrefetchEvictHandler<C, std::void_t<decltype(std::declval<C&>().set_prefetch_evict_handler(
+                                          std::function<void(Key&, Value&)>{}))>> : std::true_type {};
+
+    struct alignas(64) Stripe {
+        ShardMutex mu;
+        uint64_t version = 0;     // bumped by every put and erase of the stripe's keys
+        uint64_t promotions = 0;
+    };
+
+    Stripe& stripe(const Key& key) { return stripes_[mix64(hasher_(key)) % kStripes]; }
+
+    static uint64_t version(Stripe& s) {
+        std::scoped_lock l(s.mu);
+        return s.version;
+    }
+
+    // Core put whose evictions go to the tier; false if admission rejected the entry.
+    bool core_put(const Key& key, const Value& value) {
+        auto spill = [this](Key& k, Value& v) { tier_->put(k, v); };
+        using Result = decltype(core_->put(key, value, spill));
+        if constexpr (std::is_void_v<Result>) {
+            core_->put(key, value, spill);
+            return true;
+        } else {
+            return core_->put(key, value, spill) != Result::kRejected;
+        }
+    }
+
+    void promote(const Key& key, const Value& value, Stripe& s, uint64_t seen) {
+        std::scoped_lock l(s.mu);
+        if (s.version != seen) return;   // written or erased since the tier read
+        if (!core_put(key, value)) return;
+        tier_->erase(key);
+        ++s.promotions;
+    }
+
+    std::unique_ptr<Core> core_;
+    std::unique_ptr<Tier> tier_;
+    std::hash<Key> hasher_;
+    std::array<Stripe, kStripes> stripes_;
+};
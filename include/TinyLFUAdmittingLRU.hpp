@@ -1,7 +1,10 @@
 #pragma once
 #include <optional>
+#include <functional>
 #include "LRUCache.hpp"
 #include "CountMinSketch.hpp"
+#include "StageTimer.hpp"
+#include "Probes.hpp"
 
 template <typename Key, typename Value>
 class TinyLFUAdmittingLRU {
@@ -9,37 +12,62 @@ class TinyLFUAdmittingLRU {
         TinyLFUAdmittingLRU(size_t capacity, size_t cms_width = 4096, size_t cms_depth = 4) : lru_(capacity), cms_(cms_width, cms_depth) {}
 
         std::optional<Value> get(const Key& key) {
+            NullStageTimer t;
+            return get(key, t);
+        }
+
+        // get() that charges the sketch increment to GetStage::kCmsUpdate (StageTimer.hpp)
+        template <typename Timer>
+        std::optional<Value> get(const Key& key, Timer& t) {
             // lru cache has a map of key to it
             // it points to DLL node, MRU ordered
+            t.mark(GetStage::kBaseLookup);
             cms_.add(key);
+            t.mark(GetStage::kCmsUpdate);
             return lru_.get(key);
         }
 
-        void put(const Key& key, const Value& value) {
+        enum class PutOutcome {
+            kUpdated,   // key was present; value replaced
+            kInserted,  // room was free; nothing evicted
+            kAdmitted,  // new key won admission against the LRU victim, which was evicted
+            kRejected   // new key lost admission; cache unchanged
+        };
+
+        PutOutcome put(const Key& key, const Value& value) {
+            return put(key, value, [](Key&, Value&) {});
+        }
+
+        // put() that hands an evicted victim to on_evict(Key&, Value&) before it is dropped.
+        template <typename OnEvict>
+        PutOutcome put(const Key& key, const Value& value, OnEvict&& on_evict) {
             cms_.add(key);
             
             if (lru_.contains(key)){
                 lru_.put(key, value);
-                return;
+                return PutOutcome::kUpdated;
             }
 
             if (lru_.size() < lru_.capacity()) {
                 lru_.put(key, value);
-                return;
+                return PutOutcome::kInserted;
             }
 
             auto victim = lru_.peek_lru_key();
             if (!victim) {
-                lru_.put(key, value);
-                return;
+                lru_.put(key, value, on_evict);
+                return PutOutcome::kAdmitted;
             }
             uint32_t newEst = cms_.estimate(key);
             uint32_t victimEst = cms_.estimate(*victim);
+            PCACHE_PROBE5(tinylfu_admission, std::hash<Key>{}(key), std::hash<Key>{}(*victim),
+                          newEst, victimEst, newEst >= victimEst ? 1 : 0);
             if (newEst >= victimEst) {
-                lru_.erase(*victim);
-                lru_.put(key, value);
+                // full, so inserting evicts the LRU entry, which is *victim
+                lru_.put(key, value, on_evict);
+                return PutOutcome::kAdmitted;
             }
-
+            return PutOutcome::kRejected;
         }
 
         bool erase(const Key& key) {
@@ -62,6 +90,25 @@ class TinyLFUAdmittingLRU {
             cms_.decay_half();
         }
 
+        // Snapshot support (Snapshot.hpp): entries least recently used first, the
+        // sketch, and an insert as most recently used that bypasses admission and
+        // leaves the sketch alone (evicting the LRU entry when full).
+        template <typename F>
+        void for_each_lru_first(F&& f) const {
+            lru_.for_each_lru_first(f);
+        }
+
+        void restore(const Key& key, const Value& value) {
+            lru_.put(key, value);
+        }
+
+        void reserve(size_t n) {
+            lru_.reserve(n);
+        }
+
+        const CountMinSketch& sketch() const { return cms_; }
+        CountMinSketch& sketch() { return cms_; }
+
         
     private:
         LRUCache<Key, Value> lru_;
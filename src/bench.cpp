@@ -1,173 +1,625 @@
-#include <iostream>
-#include <random>
+// Scenario-driven benchmark driver. A scenario picks a cache and its options, a
+// workload from the workload library, thread count, measured ops or duration and
+// warmup; results go out as text, JSON or CSV together with a description of the
+// host and build (MachineInfo.hpp), so runs from different machines can be diffed.
+//
+//   bench                                      # built-in suite
+//   bench --cache wtinylfu --capacity 10000 --workload zipf:n=1000000,s=0.99
+//         --threads 8 --duration 5 --format json --out run.json
+//   bench --config scenarios.txt --format csv  # one scenario per line
+//
+// Every scenario field can be given as a flag (--cms-width 1024) or as a config
+// line entry (cms_width=1024); flags set the defaults for config lines. Fields:
+//   name cache capacity shards cms_width cms_depth topk min_count min_prob
+//   workload threads ops duration warmup value_size shadow opt seed
+// cache is one of lru, lfu, tinylfu (single-threaded only), sharded-lru,
+// wtinylfu, predictive. --dump-config prints the scenarios that would run.
+//
+// Each thread replays its own pregenerated stream (seed + thread) so key
+// generation stays out of the timed loop; warmup ops run before timing starts.
+// opt_hit_rate (Belady) is computed for single-threaded, op-count runs.
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <vector>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
 #include <string>
-#include <cmath> // std::pow
+#include <thread>
+#include <vector>
 
-#include "ShardedLRU.hpp"
+#include "LRUCache.hpp"
 #include "LFUCache.hpp"
 #include "TinyLFUAdmittingLRU.hpp"
+#include "ShardedLRU.hpp"
 #include "ShardedWTinyLFU.hpp"
 #include "PredictiveShardedCache.hpp"
+#include "Workloads.hpp"
+#include "AllocCounter.hpp"
+#include "PerfCounters.hpp"
+#include "BeladyOracle.hpp"
+#include "MachineInfo.hpp"
 
-// Generic benchmark for any cache with: get(key)->optional<V>, put(key,val), num_shards()
-template <typename Cache, typename NextKeyFn>
-double run_benchmark(Cache& cache, size_t ops, NextKeyFn&& next_key, bool warmup = true) {
-    using Clock = std::chrono::high_resolution_clock;
+using Key = uint64_t;
+using Value = std::string;
 
-    size_t hits = 0, misses = 0;
+// Longest stream kept per thread; longer runs cycle through it.
+static constexpr size_t kMaxStream = size_t(1) << 24;
+// Hot keys listed per sharded scenario.
+static constexpr size_t kReportedHotKeys = 5;
 
-    if (warmup) {
-        // quick warmup so caches/predictors learn a bit
-        const size_t warm = cache.num_shards() * 10 + 100;
-        for (size_t i = 0; i < warm; ++i) {
-            auto k = next_key();
-            if (cache.get(k)) ++hits; else { ++misses; cache.put(k, "x"); }
-        }
-        hits = misses = 0;
-    }
+struct Scenario {
+    std::string name;
+    std::string cache = "wtinylfu";
+    size_t capacity = 1000;
+    size_t shards = 8;
+    size_t cms_width = 4096;
+    size_t cms_depth = 4;
+    size_t topk = 2;
+    uint32_t min_count = 2;
+    double min_prob = 0.10;
+    std::string workload = "zipf:n=10000,s=1.2";
+    size_t threads = 1;
+    uint64_t ops = 1'000'000;   // measured ops across all threads (when duration is 0)
+    double duration_s = 0;      // > 0: run for this long instead of a fixed op count
+    uint64_t warmup = 20'000;   // per thread, untimed
+    size_t value_size = 1;
+    bool shadow = false;        // wtinylfu: shadow caches at 0.5x..4x capacity
+    bool opt = true;
+    uint64_t seed = 123;
+};
 
-    auto t0 = Clock::now();
-    for (size_t i = 0; i < ops; ++i) {
-        auto k = next_key();
-        if (cache.get(k)) ++hits; else { ++misses; cache.put(k, "x"); }
-    }
-    auto t1 = Clock::now();
-    std::chrono::duration<double> dt = t1 - t0;
+static bool parse_bool(const std::string& v) {
+    if (v == "1" || v == "true" || v == "yes") return true;
+    if (v == "0" || v == "false" || v == "no") return false;
+    throw std::invalid_argument("expected boolean: " + v);
+}
 
-    double hit_rate = (hits + misses) ? double(hits) / double(hits + misses) : 0.0;
-    std::cout << "ops=" << ops
-              << " hits=" << hits
-              << " misses=" << misses
-              << " hit_rate=" << hit_rate
-              << " time=" << dt.count() << "s"
-              << " throughput=" << (ops / std::max(1e-9, dt.count())) << " ops/s\n";
-    return hit_rate;
+static void set_field(Scenario& s, const std::string& k, const std::string& v) {
+    if (k == "name") s.name = v;
+    else if (k == "cache") s.cache = v;
+    else if (k == "capacity") s.capacity = std::stoull(v);
+    else if (k == "shards") s.shards = std::stoull(v);
+    else if (k == "cms_width") s.cms_width = std::stoull(v);
+    else if (k == "cms_depth") s.cms_depth = std::stoull(v);
+    else if (k == "topk") s.topk = std::stoull(v);
+    else if (k == "min_count") s.min_count = uint32_t(std::stoul(v));
+    else if (k == "min_prob") s.min_prob = std::stod(v);
+    else if (k == "workload") s.workload = v;
+    else if (k == "threads") s.threads = std::max<size_t>(1, std::stoull(v));
+    else if (k == "ops") s.ops = std::stoull(v);
+    else if (k == "duration") s.duration_s = std::stod(v);
+    else if (k == "warmup") s.warmup = std::stoull(v);
+    else if (k == "value_size") s.value_size = std::stoull(v);
+    else if (k == "shadow") s.shadow = parse_bool(v);
+    else if (k == "opt") s.opt = parse_bool(v);
+    else if (k == "seed") s.seed = std::stoull(v);
+    else throw std::invalid_argument("unknown scenario field: " + k);
 }
 
-int main() {
-    using Key = int;
+static std::string to_config_line(const Scenario& s) {
+    std::ostringstream os;
+    os << "name=" << s.name << " cache=" << s.cache << " capacity=" << s.capacity << " shards=" << s.shards
+       << " cms_width=" << s.cms_width << " cms_depth=" << s.cms_depth << " topk=" << s.topk
+       << " min_count=" << s.min_count << " min_prob=" << s.min_prob << " workload=" << s.workload
+       << " threads=" << s.threads << " ops=" << s.ops << " duration=" << s.duration_s << " warmup=" << s.warmup
+       << " value_size=" << s.value_size << " shadow=" << s.shadow << " opt=" << s.opt << " seed=" << s.seed;
+    return os.str();
+}
 
-    // --- knobs ---
-    const size_t key_space = 10'000;
-    const size_t capacity  = 1'000;   // 10% of key_space
-    const size_t shards    = 8;
-    const size_t ops       = 1'000'000;
+// One scenario per line: whitespace-separated key=value pairs over `base`; '#' starts a comment.
+static std::vector<Scenario> read_config_file(const std::string& path, const Scenario& base) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("cannot open config: " + path);
+    std::vector<Scenario> out;
+    std::string line;
+    while (std::getline(in, line)) {
+        const size_t hash = line.find('#');
+        if (hash != std::string::npos) line.resize(hash);
+        std::stringstream ss(line);
+        std::string kv;
+        Scenario s = base;
+        bool any = false;
+        while (ss >> kv) {
+            const size_t eq = kv.find('=');
+            if (eq == std::string::npos) throw std::invalid_argument("expected key=value: " + kv);
+            set_field(s, kv.substr(0, eq), kv.substr(eq + 1));
+            any = true;
+        }
+        if (any) out.push_back(s);
+    }
+    return out;
+}
 
-    std::mt19937 rng(123);
+// The suite run without --cache or --config: each policy on the workloads that
+// separate it from the others, then every sharded policy on the standard set.
+static std::vector<Scenario> default_suite(const Scenario& base) {
+    std::vector<Scenario> out;
+    auto add = [&](const std::string& name, const std::string& cache, const std::string& workload) {
+        Scenario s = base;
+        s.name = name;
+        s.cache = cache;
+        s.workload = workload;
+        out.push_back(s);
+        return &out.back();
+    };
+    const std::string n = std::to_string(10 * base.capacity);
+    add("uniform", "sharded-lru", "uniform:n=" + n);
+    add("zipf", "sharded-lru", "zipf:n=" + n + ",s=1.2");
+    add("loop", "sharded-lru", "loop:len=" + n);
+    add("zipf", "lfu", "zipf:n=" + n + ",s=1.2");
+    add("zipf", "wtinylfu", "zipf:n=" + n + ",s=1.2")->shadow = true;
+    add("loop", "predictive", "loop:len=" + n);
+    add("zipf", "predictive", "zipf:n=" + n + ",s=1.2");
+    for (const auto& w : standard_workloads(base.capacity))
+        for (const char* cache : {"sharded-lru", "wtinylfu", "predictive"})
+            add("lib-" + WorkloadSpec::parse(w).name, cache, w)->ops = 200'000;
+    return out;
+}
 
-    // ===== Uniform workload =====
-    {
-        ShardedLRU<Key, std::string> cache(capacity, shards);
+struct Result {
+    Scenario sc;
+    uint64_t ops = 0, hits = 0;
+    double elapsed_s = 0;
+    uint64_t allocs = 0, alloc_bytes = 0;
+    PerfCounters::Sample hw;    // summed over threads; an event is valid only if valid on all
+    double opt_hit_rate = -1;   // < 0: not computed
+    std::vector<ShadowEstimate> shadow;
+    std::optional<StageHistograms> stages;   // predictive built with PCACHE_STAGE_TIMING, in ticks
+    double ticks_per_ns = 1.0;
+    std::optional<LockStats> locks;          // sharded caches built with PCACHE_LOCK_STATS, all shards
+    std::optional<CounterSnapshot> counters; // sharded caches: built-in counters over the measured ops
+    std::vector<HotKey<Key>> hot_keys;       // sharded caches: hottest keys at the end of the run
+    std::optional<CardinalityEstimate> distinct; // sharded caches: distinct keys read, warmup included
 
-        std::uniform_int_distribution<Key> uni(0, (Key)key_space - 1);
-        auto uniform = [&]() { return uni(rng); };
+    double hit_rate() const { return ops ? double(hits) / double(ops) : 0.0; }
+    double throughput() const { return double(ops) / std::max(1e-9, elapsed_s); }
+    double per_op(double v) const { return v / double(std::max<uint64_t>(1, ops)); }
+};
 
-        std::cout << "=== Uniform workload ===\n";
-        run_benchmark(cache, ops, uniform);
-    }
+// Called once every thread has finished its warmup, before timing starts.
+template <typename Cache>
+static void on_warmed(Cache&) {}
+static void on_warmed(ShardedLRU<Key, Value>& c) { c.reset_lock_stats(); }
+static void on_warmed(ShardedWTinyLFU<Key, Value>& c) { c.reset_lock_stats(); }
+static void on_warmed(PredictiveShardedCache<Key, Value>& c) {
+    c.reset_stage_stats();
+    c.reset_lock_stats();
+}
 
-    // ===== Zipf workload =====
-    std::vector<double> weights(key_space);
-    const double s = 1.2;
-    for (size_t i = 0; i < key_space; ++i) weights[i] = 1.0 / std::pow(double(i + 1), s);
-    std::discrete_distribution<Key> zipf(weights.begin(), weights.end());
-    auto zipf_gen = [&]() { return zipf(rng); };
+// Built-in counters summed over shards, for the caches that keep them.
+template <typename Cache>
+static std::optional<CounterSnapshot> counters_of(Cache&) { return std::nullopt; }
+static std::optional<CounterSnapshot> counters_of(ShardedLRU<Key, Value>& c) { return c.stats().totals; }
+static std::optional<CounterSnapshot> counters_of(ShardedWTinyLFU<Key, Value>& c) {
+    CounterSnapshot t;
+    for (const auto& s : c.counters()) t += s;
+    return t;
+}
+static std::optional<CounterSnapshot> counters_of(PredictiveShardedCache<Key, Value>& c) { return c.stats().totals; }
 
-    {
-        ShardedLRU<Key, std::string> cache(capacity, shards);
-        std::cout << "=== Zipf(s=1.2) workload ===\n";
-        run_benchmark(cache, ops, zipf_gen);
+// Shard lock statistics merged over shards, if the build collects them.
+static void merge_locks(Result& r, const std::vector<LockStats>& shards) {
+    if (shards.empty()) return;
+    LockStats all;
+    for (const auto& s : shards) {
+        all.acquisitions += s.acquisitions;
+        all.contended += s.contended;
+        all.wait_ticks.merge(s.wait_ticks);
+        all.hold_ticks.merge(s.hold_ticks);
+        all.ticks_per_ns = s.ticks_per_ns;
     }
+    r.locks = all;
+}
 
-    // ===== Sequential burst workload (A->B->C repeating blocks) =====
-    std::vector<Key> seq;
-    seq.reserve(key_space);
-    for (Key i = 0; i < (Key)key_space; i += 3) {
-        seq.push_back(i);
-        if (i + 1 < (Key)key_space) seq.push_back(i + 1);
-        if (i + 2 < (Key)key_space) seq.push_back(i + 2);
-    }
-    size_t idx = 0;
-    auto seq_gen = [&]() {
-        Key k = seq[idx];
-        idx = (idx + 1) % seq.size();
-        return k;
+template <typename Cache>
+static Result run_on(Cache& cache, const Scenario& sc, const std::vector<std::vector<Key>>& streams) {
+    const Value value(sc.value_size, 'x');
+    struct PerThread {
+        uint64_t ops = 0, hits = 0;
+        alloc_counter::Snapshot allocs;
+        PerfCounters::Sample hw;
     };
+    std::vector<PerThread> per(sc.threads);
+    std::atomic<size_t> ready{0};
+    std::atomic<bool> go{false}, stop{false};
+
+    auto worker = [&](size_t t) {
+        const auto& s = streams[t];
+        size_t pos = 0;
+        auto access = [&] {
+            const Key k = s[pos];
+            if (++pos == s.size()) pos = 0;
+            if (cache.get(k)) return true;
+            cache.put(k, value);
+            return false;
+        };
+        for (uint64_t i = 0; i < sc.warmup; ++i) access();
 
-    {
-        ShardedLRU<Key, std::string> cache(capacity, shards);
-        std::cout << "=== Sequential burst workload ===\n";
-        run_benchmark(cache, ops, seq_gen);
-    }
-
-    // ===== LFU baseline on Zipf =====
-    std::cout << "\n=== LFU vs Zipf workload ===\n";
-    {
-        LFUCache<Key, std::string> lfu(capacity);
-        size_t hits = 0, misses = 0;
-        for (size_t i = 0; i < ops; ++i) {
-            Key k = zipf_gen();
-            if (lfu.get(k)) ++hits;
-            else { ++misses; lfu.put(k, "x"); }
+        PerThread& r = per[t];
+        PerfCounters perf;
+        ready.fetch_add(1);
+        while (!go.load()) std::this_thread::yield();
+        const auto allocs0 = alloc_counter::thread_snapshot();
+        perf.start();
+        if (sc.duration_s > 0) {
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 256; ++i) r.hits += access() ? 1 : 0;
+                r.ops += 256;
+            }
+        } else {
+            const uint64_t quota = sc.ops / sc.threads + (t < sc.ops % sc.threads ? 1 : 0);
+            for (uint64_t i = 0; i < quota; ++i) r.hits += access() ? 1 : 0;
+            r.ops = quota;
         }
-        double hit_rate = double(hits) / (hits + misses);
-        std::cout << "LFU hit_rate=" << hit_rate << "\n";
-    }
-
-    // ===== W-TinyLFU on Zipf =====
-    std::cout << "\n=== W-TinyLFU (LRU+admission) on Zipf ===\n";
-    {
-        ShardedWTinyLFU<Key, std::string> cache(capacity, shards);
-        size_t hits = 0, misses = 0;
-        for (size_t i = 0; i < ops; ++i) {
-            Key k = zipf_gen();
-            if (cache.get(k)) ++hits;
-            else { ++misses; cache.put(k, "x"); }
+        perf.stop();
+        r.allocs = alloc_counter::thread_snapshot() - allocs0;
+        r.hw = perf.read();
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t t = 0; t < sc.threads; ++t) pool.emplace_back(worker, t);
+    while (ready.load() < sc.threads) std::this_thread::yield();
+    on_warmed(cache);
+    const auto counters0 = counters_of(cache);
+    const auto t0 = std::chrono::steady_clock::now();
+    go = true;
+    if (sc.duration_s > 0) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(sc.duration_s));
+        stop = true;
+    }
+    for (auto& th : pool) th.join();
+
+    Result res;
+    res.sc = sc;
+    res.elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (counters0 && kStatsEnabled) res.counters = counters_of(cache)->since(*counters0);
+    res.hw.valid.fill(true);
+    for (const auto& r : per) {
+        res.ops += r.ops;
+        res.hits += r.hits;
+        res.allocs += r.allocs.allocs;
+        res.alloc_bytes += r.allocs.bytes_allocated;
+        for (int e = 0; e < PerfCounters::kNumEvents; ++e) {
+            res.hw.valid[e] = res.hw.valid[e] && r.hw.valid[e];
+            res.hw.value[e] += r.hw.value[e];
+        }
+    }
+    return res;
+}
+
+static void require_single_thread(const Scenario& sc) {
+    if (sc.threads != 1) throw std::invalid_argument(sc.cache + " is not thread-safe; use threads=1");
+}
+
+static Result run_scenario(const Scenario& sc) {
+    // one stream per thread, long enough for warmup plus its share of ops when that fits
+    const uint64_t measured = sc.duration_s > 0 ? kMaxStream : sc.ops / sc.threads + 1;
+    const size_t len = size_t(std::min<uint64_t>(sc.warmup + measured, kMaxStream));
+    std::vector<std::vector<Key>> streams;
+    for (size_t t = 0; t < sc.threads; ++t)
+        streams.push_back(pregenerate_keys<Key>(len, make_workload(sc.workload, sc.seed + t)));
+
+    Result r;
+    if (sc.cache == "lru") {
+        require_single_thread(sc);
+        LRUCache<Key, Value> c(sc.capacity);
+        r = run_on(c, sc, streams);
+    } else if (sc.cache == "lfu") {
+        require_single_thread(sc);
+        LFUCache<Key, Value> c(sc.capacity);
+        r = run_on(c, sc, streams);
+    } else if (sc.cache == "tinylfu") {
+        require_single_thread(sc);
+        TinyLFUAdmittingLRU<Key, Value> c(sc.capacity, sc.cms_width, sc.cms_depth);
+        r = run_on(c, sc, streams);
+    } else if (sc.cache == "sharded-lru") {
+        ShardedLRU<Key, Value> c(sc.capacity, sc.shards);
+        r = run_on(c, sc, streams);
+        merge_locks(r, c.lock_stats());
+        r.hot_keys = c.hot_keys(kReportedHotKeys);
+        r.distinct = c.distinct_keys();
+    } else if (sc.cache == "wtinylfu") {
+        ShardedWTinyLFU<Key, Value> c(sc.capacity, sc.shards, sc.cms_width, sc.cms_depth);
+        if (sc.shadow) c.enable_shadow_caches({0.5, 1.0, 2.0, 4.0}, /*sample_rate=*/0.05);
+        r = run_on(c, sc, streams);
+        merge_locks(r, c.lock_stats());
+        r.hot_keys = c.hot_keys(kReportedHotKeys);
+        r.distinct = c.distinct_keys();
+        if (sc.shadow) r.shadow = c.stats().shadow;
+    } else if (sc.cache == "predictive") {
+        PredictiveShardedCache<Key, Value>::Options o;
+        o.shards = sc.shards;
+        o.cms_width = sc.cms_width;
+        o.cms_depth = sc.cms_depth;
+        o.prefetch_topk = sc.topk;
+        o.min_trans_count = sc.min_count;
+        o.min_trans_prob = sc.min_prob;
+        PredictiveShardedCache<Key, Value> c(sc.capacity, o);
+        r = run_on(c, sc, streams);
+        const auto ss = c.stage_stats();
+        if (ss.enabled) {
+            r.stages.emplace();
+            for (const auto& shard : ss.shards)
+                for (size_t s = 0; s < shard.size(); ++s) (*r.stages)[s].merge(shard[s]);
+            r.ticks_per_ns = ss.ticks_per_ns;
         }
-        double hit_rate = double(hits) / (hits + misses);
-        std::cout << "W-TinyLFU hit_rate=" << hit_rate << "\n";
+        auto locks = c.lock_stats();   // the predictive layer's shard locks, then the base cache's
+        const auto base = c.base_lock_stats();
+        locks.insert(locks.end(), base.begin(), base.end());
+        merge_locks(r, locks);
+        r.hot_keys = c.hot_keys(kReportedHotKeys);
+        r.distinct = c.distinct_keys();
+    } else {
+        throw std::invalid_argument("unknown cache: " + sc.cache);
     }
 
-    // ===== Predictive (Markov) on Sequential =====
-    std::cout << "\n=== Predictive (Markov) on Sequential workload ===\n";
-    {
-        typename PredictiveShardedCache<Key, std::string>::Options opts;
-        opts.shards = shards;
-        opts.prefetch_topk = 2;      // try 1–3
-        opts.min_trans_count = 2;
-        opts.min_trans_prob  = 0.10;
-        opts.enable_prefetch = true;
+    // OPT over exactly the measured requests, when they are one uncycled stream
+    if (sc.opt && sc.threads == 1 && sc.duration_s <= 0 && sc.warmup + sc.ops <= len)
+        r.opt_hit_rate = BeladyOracle(streams[0]).hit_rate(sc.capacity, sc.warmup, sc.warmup + sc.ops);
+    return r;
+}
 
-        PredictiveShardedCache<Key, std::string> pcache(capacity, opts);
+// ---- output ----
 
-        // small warmup to let model learn transitions
-        run_benchmark(pcache, 10'000, seq_gen, /*warmup=*/true);
+static std::string json_str(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if (static_cast<unsigned char>(c) < 0x20) out += ' ';
+        else out += c;
+    }
+    return out + "\"";
+}
 
-        // now measure (no extra warmup)
-        run_benchmark(pcache, ops, seq_gen, /*warmup=*/false);
+static std::string csv_str(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"') out += '"';
+        out += c;
     }
+    return out + "\"";
+}
 
-    // ===== Predictive (Markov) on Zipf =====
-    std::cout << "\n=== Predictive (Markov) on Zipf ===\n";
-    {
-        typename PredictiveShardedCache<Key, std::string>::Options opts;
-        opts.shards = shards;
-        opts.prefetch_topk = 2;
-        opts.min_trans_count = 2;
-        opts.min_trans_prob  = 0.10;
-        opts.enable_prefetch = true;
+static void write_machine_text(std::ostream& os, const MachineInfo& m) {
+    os << "# host=" << m.host << " cpu=\"" << m.cpu_model << "\" cores=" << m.logical_cores << " os=" << m.os
+       << " compiler=\"" << m.compiler << "\" build=" << m.build_type << " flags=\"" << m.cxx_flags << "\""
+       << " options=\"" << m.build_options << "\""
+       << " at " << m.timestamp << "\n";
+}
 
-        PredictiveShardedCache<Key, std::string> pcache(capacity, opts);
+static void write_result_text(std::ostream& os, const Result& r) {
+    const Scenario& s = r.sc;
+    os << "=== " << s.name << ": " << s.cache << " capacity=" << s.capacity << " workload=" << s.workload
+       << " threads=" << s.threads << " ===\n"
+       << "ops=" << r.ops << " hits=" << r.hits << " misses=" << r.ops - r.hits
+       << " hit_rate=" << r.hit_rate() << " time=" << r.elapsed_s << "s"
+       << " throughput=" << r.throughput() << " ops/s"
+       << " allocs/op=" << r.per_op(double(r.allocs)) << " bytes/op=" << r.per_op(double(r.alloc_bytes));
+    // hardware counters per op, only those the kernel let us open
+    for (int e = 0; e < PerfCounters::kNumEvents; ++e)
+        if (r.hw.valid[e]) os << " " << PerfCounters::name(PerfCounters::Event(e)) << "/op=" << r.per_op(r.hw.value[e]);
+    os << "\n";
+    if (r.opt_hit_rate >= 0)
+        os << "  OPT hit_rate=" << r.opt_hit_rate
+           << " (policy reaches " << (r.opt_hit_rate > 0 ? r.hit_rate() / r.opt_hit_rate : 0.0) << " of OPT)\n";
+    if (r.stages) {
+        const auto ns = [&](double ticks) { return ticks / r.ticks_per_ns; };
+        for (size_t s = 0; s < r.stages->size(); ++s) {
+            const LogHistogram& h = (*r.stages)[s];
+            os << "  stage " << stage_name(GetStage(s)) << " mean=" << ns(h.mean()) << "ns"
+               << " p50=" << ns(double(h.percentile(0.50))) << "ns p99=" << ns(double(h.percentile(0.99))) << "ns"
+               << " max=" << ns(double(h.max())) << "ns sampled=" << h.count() << "\n";
+        }
+    }
+    if (r.counters) {
+        const CounterSnapshot& c = *r.counters;
+        os << "  counters puts=" << c.puts << " evictions=" << c.evictions << " admitted=" << c.admitted
+           << " rejected=" << c.rejected << " prefetch_issued=" << c.prefetch_issued
+           << " prefetch_used=" << c.prefetch_used << " prefetch_wasted=" << c.prefetch_wasted
+           << " predictor_states=" << c.predictor_states << " predictor_edges=" << c.predictor_edges << "\n";
+    }
+    if (!r.hot_keys.empty()) {
+        os << "  hot_keys";
+        for (const auto& h : r.hot_keys) os << ' ' << h.key << "@" << h.shard << "~" << h.count;
+        os << "\n";
+    }
+    if (r.distinct && kStatsEnabled)
+        os << "  distinct_keys=" << std::llround(r.distinct->retained) << " suggested_capacity=" << r.distinct->suggested_capacity
+           << " suggested_cms_width=" << r.distinct->suggested_cms_width << "\n";
+    if (r.locks) {
+        const LockStats& l = *r.locks;
+        const auto ns = [&](uint64_t ticks) { return double(ticks) / l.ticks_per_ns; };
+        os << "  locks acquisitions=" << l.acquisitions << " contended=" << l.contended
+           << " (" << l.contention_rate() << ")"
+           << " wait_p50=" << ns(l.wait_ticks.percentile(0.50)) << "ns wait_p99=" << ns(l.wait_ticks.percentile(0.99)) << "ns"
+           << " hold_p50=" << ns(l.hold_ticks.percentile(0.50)) << "ns hold_p99=" << ns(l.hold_ticks.percentile(0.99)) << "ns\n";
+    }
+    for (const auto& e : r.shadow)
+        os << "  shadow x" << e.factor << " (cap=" << e.virtual_capacity << ")"
+           << " est_hit_rate=" << e.hit_rate << " sampled=" << e.accesses << "\n";
+}
 
-        // small warmup so the predictor sees some transitions
-        run_benchmark(pcache, 10'000, zipf_gen, /*warmup=*/true);
+static void write_json(std::ostream& os, const MachineInfo& m, const std::vector<Result>& results) {
+    os << "{\n  \"machine\": {\"host\": " << json_str(m.host) << ", \"cpu_model\": " << json_str(m.cpu_model)
+       << ", \"logical_cores\": " << m.logical_cores << ", \"os\": " << json_str(m.os)
+       << ", \"compiler\": " << json_str(m.compiler) << ", \"build_type\": " << json_str(m.build_type)
+       << ", \"cxx_flags\": " << json_str(m.cxx_flags) << ", \"build_options\": " << json_str(m.build_options)
+       << ", \"timestamp\": " << json_str(m.timestamp) << "},\n"
+       << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        const Scenario& s = r.sc;
+        os << (i ? ",\n" : "\n") << "    {\"name\": " << json_str(s.name) << ", \"cache\": " << json_str(s.cache)
+           << ", \"capacity\": " << s.capacity << ", \"shards\": " << s.shards << ", \"cms_width\": " << s.cms_width
+           << ", \"cms_depth\": " << s.cms_depth << ", \"topk\": " << s.topk << ", \"min_count\": " << s.min_count
+           << ", \"min_prob\": " << s.min_prob << ", \"workload\": " << json_str(s.workload)
+           << ", \"threads\": " << s.threads << ", \"warmup\": " << s.warmup << ", \"value_size\": " << s.value_size
+           << ", \"seed\": " << s.seed
+           << ",\n     \"ops\": " << r.ops << ", \"hits\": " << r.hits << ", \"hit_rate\": " << r.hit_rate()
+           << ", \"elapsed_s\": " << r.elapsed_s << ", \"throughput\": " << r.throughput()
+           << ", \"allocs_per_op\": " << r.per_op(double(r.allocs))
+           << ", \"bytes_per_op\": " << r.per_op(double(r.alloc_bytes));
+        for (int e = 0; e < PerfCounters::kNumEvents; ++e)
+            if (r.hw.valid[e])
+                os << ", \"" << PerfCounters::name(PerfCounters::Event(e)) << "_per_op\": " << r.per_op(r.hw.value[e]);
+        os << ", \"opt_hit_rate\": ";
+        if (r.opt_hit_rate >= 0) os << r.opt_hit_rate; else os << "null";
+        if (r.stages) {
+            os << ", \"stages_ns\": {";
+            for (size_t s = 0; s < r.stages->size(); ++s) {
+                const LogHistogram& h = (*r.stages)[s];
+                os << (s ? ", " : "") << "\"" << stage_name(GetStage(s)) << "\": {\"mean\": " << h.mean() / r.ticks_per_ns
+                   << ", \"p50\": " << double(h.percentile(0.50)) / r.ticks_per_ns
+                   << ", \"p99\": " << double(h.percentile(0.99)) / r.ticks_per_ns
+                   << ", \"max\": " << double(h.max()) / r.ticks_per_ns << ", \"sampled\": " << h.count() << "}";
+            }
+            os << "}";
+        }
+        if (r.counters) {
+            const CounterSnapshot& c = *r.counters;
+            os << ", \"counters\": {\"puts\": " << c.puts << ", \"evictions\": " << c.evictions
+               << ", \"admitted\": " << c.admitted << ", \"rejected\": " << c.rejected
+               << ", \"prefetch_issued\": " << c.prefetch_issued << ", \"prefetch_used\": " << c.prefetch_used
+               << ", \"prefetch_wasted\": " << c.prefetch_wasted << ", \"predictor_states\": " << c.predictor_states
+               << ", \"predictor_edges\": " << c.predictor_edges << ", \"size\": " << c.size << "}";
+        }
+        if (r.locks) {
+            const LockStats& l = *r.locks;
+            os << ", \"locks\": {\"acquisitions\": " << l.acquisitions << ", \"contended\": " << l.contended
+               << ", \"wait_p50_ns\": " << double(l.wait_ticks.percentile(0.50)) / l.ticks_per_ns
+               << ", \"wait_p99_ns\": " << double(l.wait_ticks.percentile(0.99)) / l.ticks_per_ns
+               << ", \"hold_p50_ns\": " << double(l.hold_ticks.percentile(0.50)) / l.ticks_per_ns
+               << ", \"hold_p99_ns\": " << double(l.hold_ticks.percentile(0.99)) / l.ticks_per_ns << "}";
+        }
+        if (!r.hot_keys.empty()) {
+            os << ", \"hot_keys\": [";
+            for (size_t j = 0; j < r.hot_keys.size(); ++j) {
+                const auto& h = r.hot_keys[j];
+                os << (j ? ", " : "") << "{\"key\": " << h.key << ", \"shard\": " << h.shard
+                   << ", \"count\": " << h.count << ", \"error\": " << h.error << "}";
+            }
+            os << "]";
+        }
+        if (r.distinct && kStatsEnabled)
+            os << ", \"distinct_keys\": " << r.distinct->retained << ", \"suggested_capacity\": " << r.distinct->suggested_capacity
+               << ", \"suggested_cms_width\": " << r.distinct->suggested_cms_width;
+        if (!r.shadow.empty()) {
+            os << ", \"shadow\": [";
+            for (size_t j = 0; j < r.shadow.size(); ++j) {
+                const auto& e = r.shadow[j];
+                os << (j ? ", " : "") << "{\"factor\": " << e.factor << ", \"capacity\": " << e.virtual_capacity
+                   << ", \"hit_rate\": " << e.hit_rate << ", \"sampled\": " << e.accesses << "}";
+            }
+            os << "]";
+        }
+        os << "}";
+    }
+    os << "\n  ]\n}\n";
+}
 
-        // measure
-        run_benchmark(pcache, ops, zipf_gen, /*warmup=*/false);
+// One row per scenario; machine columns repeat so rows from several runs can be concatenated.
+static void write_csv(std::ostream& os, const MachineInfo& m, const std::vector<Result>& results) {
+    os << "host,cpu_model,logical_cores,compiler,build_type,cxx_flags,build_options,timestamp,"
+          "name,cache,capacity,shards,cms_width,cms_depth,topk,min_count,min_prob,workload,threads,warmup,value_size,"
+          "ops,hits,hit_rate,elapsed_s,throughput,allocs_per_op,bytes_per_op";
+    for (int e = 0; e < PerfCounters::kNumEvents; ++e) os << ',' << PerfCounters::name(PerfCounters::Event(e)) << "_per_op";
+    os << ",opt_hit_rate\n";
+    for (const auto& r : results) {
+        const Scenario& s = r.sc;
+        os << csv_str(m.host) << ',' << csv_str(m.cpu_model) << ',' << m.logical_cores << ',' << csv_str(m.compiler)
+           << ',' << csv_str(m.build_type) << ',' << csv_str(m.cxx_flags) << ',' << csv_str(m.build_options) << ','
+           << m.timestamp << ','
+           << csv_str(s.name) << ',' << s.cache << ',' << s.capacity << ',' << s.shards << ',' << s.cms_width << ','
+           << s.cms_depth << ',' << s.topk << ',' << s.min_count << ',' << s.min_prob << ',' << csv_str(s.workload)
+           << ',' << s.threads << ',' << s.warmup << ',' << s.value_size << ','
+           << r.ops << ',' << r.hits << ',' << r.hit_rate() << ',' << r.elapsed_s << ',' << r.throughput() << ','
+           << r.per_op(double(r.allocs)) << ',' << r.per_op(double(r.alloc_bytes));
+        for (int e = 0; e < PerfCounters::kNumEvents; ++e) {
+            os << ',';
+            if (r.hw.valid[e]) os << r.per_op(r.hw.value[e]);
+        }
+        os << ',';
+        if (r.opt_hit_rate >= 0) os << r.opt_hit_rate;
+        os << '\n';
     }
+}
 
+static void usage() {
+    std::cerr << "usage: bench [--config FILE] [--format text|json|csv] [--out FILE] [--dump-config]\n"
+                 "             [--name N] [--cache lru|lfu|tinylfu|sharded-lru|wtinylfu|predictive]\n"
+                 "             [--capacity C] [--shards S] [--cms-width W] [--cms-depth D]\n"
+                 "             [--topk K] [--min-count N] [--min-prob P] [--workload SPEC]\n"
+                 "             [--threads T] [--ops N | --duration S] [--warmup N] [--value-size B]\n"
+                 "             [--shadow] [--no-opt] [--seed N]\n"
+                 "Without --cache or --config the built-in suite runs (the other flags still apply).\n"
+                 "workloads (SPEC is name or name:param=value,...; defaults shown):\n" << workload_help();
+}
 
+int main(int argc, char** argv) {
+    Scenario base;
+    std::string config, format = "text", out_path;
+    bool single = false, dump = false;
+    std::vector<Scenario> scenarios;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string a = argv[i];
+            if (a == "-h" || a == "--help") { usage(); return 0; }
+            if (a == "--shadow") { base.shadow = true; continue; }
+            if (a == "--no-opt") { base.opt = false; continue; }
+            if (a == "--dump-config") { dump = true; continue; }
+            if (a.compare(0, 2, "--") != 0 || i + 1 >= argc) { usage(); return 2; }
+            const std::string v = argv[++i];
+            if (a == "--config") config = v;
+            else if (a == "--format") format = v;
+            else if (a == "--out") out_path = v;
+            else {
+                std::string field = a.substr(2);
+                std::replace(field.begin(), field.end(), '-', '_');
+                set_field(base, field, v);
+                if (field == "cache") single = true;
+            }
+        }
+        if (format != "text" && format != "json" && format != "csv")
+            throw std::invalid_argument("unknown format: " + format);
+        if (!config.empty()) scenarios = read_config_file(config, base);
+        else if (single) scenarios.push_back(base);
+        else scenarios = default_suite(base);
+        for (auto& s : scenarios)
+            if (s.name.empty()) s.name = WorkloadSpec::parse(s.workload).name;
+    } catch (const std::exception& e) {
+        std::cerr << "bench: " << e.what() << "\n";
+        return 2;
+    }
+    if (dump) {
+        for (const auto& s : scenarios) std::cout << to_config_line(s) << "\n";
+        return 0;
+    }
+
+    std::ofstream file;
+    if (!out_path.empty()) {
+        file.open(out_path);
+        if (!file) { std::cerr << "bench: cannot write " << out_path << "\n"; return 2; }
+    }
+    std::ostream& os = out_path.empty() ? std::cout : file;
+
+    // text streams each result as it finishes; JSON and CSV are written at the end
+    const MachineInfo machine = MachineInfo::collect();
+    if (format == "text") write_machine_text(os, machine);
+    std::vector<Result> results;
+    try {
+        for (const auto& s : scenarios) {
+            results.push_back(run_scenario(s));
+            if (format == "text") write_result_text(os << std::flush, results.back());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "bench: " << e.what() << "\n";
+        return 2;
+    }
+    if (format == "json") write_json(os, machine, results);
+    else if (format == "csv") write_csv(os, machine, results);
     return 0;
 }
@@ -0,0 +1,206 @@
+// End-to-end benchmark with a miss penalty: client threads issue requests at a fixed
+// aggregate rate against a cache in front of a SimulatedBackend. A miss fetches from
+// the backend and fills the cache. For PredictiveShardedCache, predicted keys are
+// loaded asynchronously through the same backend (set_prefetcher), so prefetches
+// compete with demand misses for backend concurrency.
+//
+// The offered load (--rate) and the key stream are identical for every cache, so
+// throughput, latency and backend load are directly comparable. Load is open-loop
+// (OpenLoopDriver.hpp): latency runs from the intended send time, so a request
+// queued behind a slow miss is charged for the wait. --workload SPEC (repeatable)
+// picks key streams from the workload library; the default is a loop and a Zipf.
+//
+//   e2e_bench --rate 20000 --clients 32 --duration 3 --latency-us 500 --dist exp
+//             --concurrency 32 --overhead-us 20 --capacity 1000
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "ShardedWTinyLFU.hpp"
+#include "PredictiveShardedCache.hpp"
+#include "OpenLoopDriver.hpp"
+#include "SimulatedBackend.hpp"
+#include "Workloads.hpp"
+
+using Key = uint64_t;
+using Value = std::string;
+
+struct RunConfig {
+    size_t capacity = 1000;
+    size_t shards = 8;
+    OpenLoopOptions load{20000.0, 32, 3.0, OpenLoopOptions::Arrival::kConstant}; // rate, clients, duration
+    BackendOptions backend;
+};
+
+struct RunResult : OpenLoopResult {
+    uint64_t backend_requests = 0;
+};
+
+// Clients share one pregenerated stream through an atomic cursor, so the global request
+// order is the same for every cache. Arrivals follow the open-loop schedule, and
+// latency counts from the intended send time.
+template <typename Access>
+static RunResult drive(const RunConfig& cfg, const std::vector<Key>& keys, Access&& access) {
+    std::atomic<size_t> cursor{0};
+    RunResult r;
+    static_cast<OpenLoopResult&>(r) = run_open_loop(cfg.load, [&](size_t) {
+        return access(keys[cursor.fetch_add(1, std::memory_order_relaxed) % keys.size()]);
+    });
+    return r;
+}
+
+static RunResult run_wtinylfu(const RunConfig& cfg, const std::vector<Key>& keys) {
+    ShardedWTinyLFU<Key, Value> cache(cfg.capacity, cfg.shards);
+    SimulatedBackend backend(cfg.backend);
+    RunResult r = drive(cfg, keys, [&](Key k) {
+        if (cache.get(k)) return true;
+        cache.put(k, backend.fetch(k));
+        return false;
+    });
+    r.backend_requests = backend.requests();
+    return r;
+}
+
+static RunResult run_predictive(const RunConfig& cfg, const std::vector<Key>& keys) {
+    PredictiveShardedCache<Key, Value>::Options opt;
+    opt.shards = cfg.shards;
+    opt.prefetch_topk = 2;
+    opt.min_trans_count = 2;
+    opt.min_trans_prob = 0.10;
+    PredictiveShardedCache<Key, Value> cache(cfg.capacity, opt);
+
+    // keys with a prefetch in flight, so a prediction repeated before the load
+    // completes is not fetched twice
+    std::mutex inflight_mu;
+    std::unordered_set<Key> inflight;
+
+    RunResult r;
+    {
+        SimulatedBackend backend(cfg.backend); // destroyed (drained) before cache and inflight
+        cache.set_prefetcher([&](const Key& k) {
+            {
+                std::scoped_lock l(inflight_mu);
+                if (!inflight.insert(k).second) return;
+            }
+            backend.fetch_async(k, [&](Key key, Value v) {
+                cache.put_prefetched(key, v);
+                std::scoped_lock l(inflight_mu);
+                inflight.erase(key);
+            });
+        });
+        r = drive(cfg, keys, [&](Key k) {
+            if (cache.get(k)) return true;
+            cache.put(k, backend.fetch(k));
+            return false;
+        });
+        r.backend_requests = backend.requests();
+    }
+    cache.set_prefetcher(nullptr);
+    return r;
+}
+
+static void report(const std::string& workload, const std::string& cache, const RunResult& r) {
+    auto us = [](uint64_t ns) { return double(ns) / 1000.0; };
+    std::cout << std::left << std::setw(10) << workload << std::setw(12) << cache << std::right << std::fixed
+              << std::setprecision(0)
+              << std::setw(10) << r.offered_rate
+              << std::setw(10) << r.achieved_rate
+              << std::setprecision(3)
+              << std::setw(9) << (r.completed ? double(r.hits) / double(r.completed) : 0.0)
+              << std::setprecision(1)
+              << std::setw(10) << r.latency_ns.mean() / 1000.0
+              << std::setw(10) << us(r.latency_ns.percentile(0.50))
+              << std::setw(10) << us(r.latency_ns.percentile(0.99))
+              << std::setw(10) << us(r.latency_ns.percentile(0.999))
+              << std::setw(10) << r.backend_requests << "\n";
+}
+
+static void usage() {
+    std::cerr << "usage: e2e_bench [--rate R] [--clients N] [--duration S] [--capacity C] [--shards S]\n"
+                 "                 [--latency-us US] [--dist const|uniform|exp|lognormal] [--spread X]\n"
+                 "                 [--overhead-us US] [--concurrency N] [--async-workers N]\n"
+                 "                 [--arrival constant|poisson] [--workload SPEC]...\n"
+                 "workloads (SPEC is name or name:param=value,...; defaults shown):\n" << workload_help();
+}
+
+static size_t positive(const std::string& flag, const std::string& v) {
+    const size_t n = std::stoull(v);
+    if (n == 0) throw std::invalid_argument(flag + " must be > 0");
+    return n;
+}
+
+int main(int argc, char** argv) {
+    RunConfig cfg;
+    std::vector<std::string> workloads;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string a = argv[i];
+            if (a == "-h" || a == "--help") { usage(); return 0; }
+            if (i + 1 >= argc) { usage(); return 2; }
+            const std::string v = argv[++i];
+            if (a == "--rate") {
+                cfg.load.rate = std::stod(v);
+                if (!(cfg.load.rate > 0)) throw std::invalid_argument("--rate must be > 0");
+            }
+            else if (a == "--clients") cfg.load.threads = std::max<size_t>(1, std::stoull(v));
+            else if (a == "--duration") cfg.load.duration_s = std::stod(v);
+            else if (a == "--capacity") cfg.capacity = positive(a, v);
+            else if (a == "--shards") cfg.shards = positive(a, v);
+            else if (a == "--latency-us") cfg.backend.mean_us = std::stod(v);
+            else if (a == "--spread") cfg.backend.spread = std::stod(v);
+            else if (a == "--overhead-us") cfg.backend.overhead_us = std::stod(v);
+            else if (a == "--concurrency") cfg.backend.concurrency = std::max<size_t>(1, std::stoull(v));
+            else if (a == "--async-workers") cfg.backend.async_workers = std::max<size_t>(1, std::stoull(v));
+            else if (a == "--workload") workloads.push_back(v);
+            else if (a == "--arrival") {
+                if (v == "constant") cfg.load.arrival = OpenLoopOptions::Arrival::kConstant;
+                else if (v == "poisson") cfg.load.arrival = OpenLoopOptions::Arrival::kPoisson;
+                else throw std::invalid_argument("unknown --arrival " + v);
+            } else if (a == "--dist") {
+                using L = BackendOptions::Latency;
+                if (v == "const") cfg.backend.dist = L::kConstant;
+                else if (v == "uniform") cfg.backend.dist = L::kUniform;
+                else if (v == "exp") cfg.backend.dist = L::kExponential;
+                else if (v == "lognormal") cfg.backend.dist = L::kLognormal;
+                else throw std::invalid_argument("unknown --dist " + v);
+            } else { usage(); return 2; }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "e2e_bench: " << e.what() << "\n";
+        return 2;
+    }
+
+    // default: a loop over 3x capacity (sequential reuse that plain recency/frequency
+    // cannot hold) and a Zipf over 100x capacity
+    if (workloads.empty()) {
+        workloads.push_back("loop:len=" + std::to_string(3 * cfg.capacity));
+        workloads.push_back("zipf:n=" + std::to_string(100 * cfg.capacity) + ",s=0.99");
+    }
+    std::vector<std::pair<std::string, std::vector<Key>>> streams;
+    try {
+        for (const auto& w : workloads)
+            streams.emplace_back(WorkloadSpec::parse(w).name, pregenerate_keys<Key>(1 << 20, make_workload(w, 123)));
+    } catch (const std::exception& e) {
+        std::cerr << "e2e_bench: " << e.what() << "\n";
+        return 2;
+    }
+
+    std::cout << std::left << std::setw(10) << "workload" << std::setw(12) << "cache" << std::right
+              << std::setw(10) << "offered" << std::setw(10) << "achieved" << std::setw(9) << "hit_rate"
+              << std::setw(10) << "mean_us" << std::setw(10) << "p50_us" << std::setw(10) << "p99_us"
+              << std::setw(10) << "p999_us" << std::setw(10) << "backend" << "\n";
+    for (const auto& [name, keys] : streams) {
+        report(name, "wtinylfu", run_wtinylfu(cfg, keys));
+        report(name, "predictive", run_predictive(cfg, keys));
+    }
+    return 0;
+}
@@ -0,0 +1,200 @@
+// Open-loop load sweep: for each cache and each offered rate, threads issue get (plus
+// put on miss) on a fixed Poisson or constant-rate schedule and latency is measured
+// from the intended send time (see OpenLoopDriver.hpp). Plotting p50/p99/p999
+// against offered load gives the throughput-latency curve of each cache; the knee
+// is where achieved falls below offered and the tail explodes.
+//
+//   loadgen --caches lru,wtinylfu,predictive --rates 100000,200000,400000,800000
+//           --threads 4 --duration 1 --arrival poisson > curve.csv
+//
+// --decay-ms N runs PredictiveShardedCache::decay_models() every N ms from a
+// background thread, so its lock-hold stalls show up in the tail.
+// --metrics-port P serves the built-in counters of the cache under test at
+// http://127.0.0.1:P/metrics (Prometheus) and /metrics.json while the sweep runs.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ShardedLRU.hpp"
+#include "ShardedWTinyLFU.hpp"
+#include "PredictiveShardedCache.hpp"
+#include "OpenLoopDriver.hpp"
+#include "MetricsExporter.hpp"
+#include "Workloads.hpp"
+
+using Key = uint64_t;
+using Value = uint64_t;
+
+struct LoadConfig {
+    std::vector<std::string> caches{"lru", "wtinylfu", "predictive"};
+    std::vector<double> rates{50000, 100000, 200000, 400000, 800000};
+    OpenLoopOptions run;
+    size_t capacity = 10000;
+    size_t shards = 8;
+    std::string workload = "zipf:n=100000,s=0.99";
+    size_t keys_per_thread = 1 << 18;
+    unsigned decay_ms = 0;
+    int metrics_port = -1;
+};
+
+template <typename T>
+static std::vector<T> parse_list(const std::string& s) {
+    std::vector<T> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) continue;
+        std::stringstream is(item);
+        T v;
+        if (!(is >> v)) throw std::invalid_argument("bad list item " + item);
+        out.push_back(v);
+    }
+    return out;
+}
+
+static MetricsRegistry g_metrics;
+
+template <typename Cache>
+static OpenLoopResult sweep_point(Cache& cache, const LoadConfig& cfg, double rate,
+                                  const std::vector<std::vector<Key>>& streams) {
+    g_metrics.add("loadgen", cache);
+    struct Unregister { ~Unregister() { g_metrics.remove("loadgen"); } } unregister;
+
+    // untimed warmup so every rate point starts from a full cache
+    for (Key k : streams[0]) if (!cache.get(k)) cache.put(k, k);
+
+    std::vector<size_t> cursor(streams.size(), 0);
+    OpenLoopOptions o = cfg.run;
+    o.rate = rate;
+    return run_open_loop(o, [&](size_t t) {
+        const auto& s = streams[t];
+        const Key k = s[cursor[t]++ % s.size()];
+        if (cache.get(k)) return true;
+        cache.put(k, k);
+        return false;
+    });
+}
+
+static void print_row(const std::string& cache, const LoadConfig& cfg, const OpenLoopResult& r) {
+    auto us = [](uint64_t ns) { return double(ns) / 1000.0; };
+    std::cout << cache << ",\"" << cfg.workload << "\"," << (cfg.run.arrival == OpenLoopOptions::Arrival::kPoisson ? "poisson" : "constant") << ','
+              << cfg.run.threads << ',' << r.offered_rate << ',' << r.achieved_rate << ','
+              << (r.completed ? double(r.hits) / double(r.completed) : 0.0) << ',' << r.unsent << ','
+              << us(r.latency_ns.percentile(0.50)) << ',' << us(r.latency_ns.percentile(0.90)) << ','
+              << us(r.latency_ns.percentile(0.99)) << ',' << us(r.latency_ns.percentile(0.999)) << ','
+              << us(r.latency_ns.max()) << ',' << us(r.service_ns.percentile(0.99)) << '\n';
+    std::cout.flush();
+}
+
+static size_t positive(const std::string& flag, const std::string& v) {
+    const size_t n = std::stoull(v);
+    if (n == 0) throw std::invalid_argument(flag + " must be > 0");
+    return n;
+}
+
+static void usage() {
+    std::cerr << "usage: loadgen [--caches lru,wtinylfu,predictive] [--rates R1,R2,...] [--threads N]\n"
+                 "               [--duration S] [--arrival poisson|constant] [--capacity C] [--shards S]\n"
+                 "               [--workload SPEC] [--decay-ms MS] [--seed N] [--metrics-port P]\n"
+                 "workloads (SPEC is name or name:param=value,...; defaults shown):\n" << workload_help();
+}
+
+int main(int argc, char** argv) {
+    LoadConfig cfg;
+    cfg.run.threads = 4;
+    cfg.run.duration_s = 1.0;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string a = argv[i];
+            if (a == "-h" || a == "--help") { usage(); return 0; }
+            if (i + 1 >= argc) { usage(); return 2; }
+            const std::string v = argv[++i];
+            if (a == "--caches") cfg.caches = parse_list<std::string>(v);
+            else if (a == "--rates") {
+                cfg.rates = parse_list<double>(v);
+                for (double r : cfg.rates)
+                    if (!(r > 0)) throw std::invalid_argument("--rates must be > 0");
+            }
+            else if (a == "--threads") cfg.run.threads = std::max<size_t>(1, std::stoull(v));
+            else if (a == "--duration") cfg.run.duration_s = std::stod(v);
+            else if (a == "--capacity") cfg.capacity = positive(a, v);
+            else if (a == "--shards") cfg.shards = positive(a, v);
+            else if (a == "--workload") cfg.workload = v;
+            else if (a == "--decay-ms") cfg.decay_ms = unsigned(std::stoul(v));
+            else if (a == "--seed") cfg.run.seed = std::stoull(v);
+            else if (a == "--metrics-port") cfg.metrics_port = std::stoi(v);
+            else if (a == "--arrival") {
+                if (v == "poisson") cfg.run.arrival = OpenLoopOptions::Arrival::kPoisson;
+                else if (v == "constant") cfg.run.arrival = OpenLoopOptions::Arrival::kConstant;
+                else throw std::invalid_argument("unknown --arrival " + v);
+            } else { usage(); return 2; }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "loadgen: " << e.what() << "\n";
+        return 2;
+    }
+
+    // one pregenerated stream per thread so key generation stays off the timed path
+    std::vector<std::vector<Key>> streams;
+    try {
+        for (size_t t = 0; t < cfg.run.threads; ++t)
+            streams.push_back(pregenerate_keys<Key>(cfg.keys_per_thread, make_workload(cfg.workload, cfg.run.seed + t)));
+    } catch (const std::exception& e) {
+        std::cerr << "loadgen: " << e.what() << "\n";
+        return 2;
+    }
+
+    std::unique_ptr<MetricsHttpServer> server;
+    if (cfg.metrics_port >= 0) {
+        try {
+            server = std::make_unique<MetricsHttpServer>(g_metrics, uint16_t(cfg.metrics_port));
+        } catch (const std::exception& e) {
+            std::cerr << "loadgen: " << e.what() << "\n";
+            return 2;
+        }
+        std::cerr << "metrics on http://127.0.0.1:" << server->port() << "/metrics\n";
+    }
+
+    std::cout << "cache,workload,arrival,threads,offered,achieved,hit_rate,unsent,p50_us,p90_us,p99_us,p999_us,max_us,service_p99_us\n";
+    for (const auto& name : cfg.caches) {
+        for (double rate : cfg.rates) {
+            if (name == "lru") {
+                ShardedLRU<Key, Value> cache(cfg.capacity, cfg.shards);
+                print_row(name, cfg, sweep_point(cache, cfg, rate, streams));
+            } else if (name == "wtinylfu") {
+                ShardedWTinyLFU<Key, Value> cache(cfg.capacity, cfg.shards);
+                print_row(name, cfg, sweep_point(cache, cfg, rate, streams));
+            } else if (name == "predictive") {
+                PredictiveShardedCache<Key, Value>::Options opt;
+                opt.shards = cfg.shards;
+                PredictiveShardedCache<Key, Value> cache(cfg.capacity, opt);
+                std::atomic<bool> stop{false};
+                std::thread decay;
+                if (cfg.decay_ms) {
+                    decay = std::thread([&] {
+                        while (!stop.load()) {
+                            std::this_thread::sleep_for(std::chrono::milliseconds(cfg.decay_ms));
+                            cache.decay_models();
+                        }
+                    });
+                }
+                const OpenLoopResult r = sweep_point(cache, cfg, rate, streams);
+                stop = true;
+                if (decay.joinable()) decay.join();
+                print_row(name, cfg, r);
+            } else {
+                std::cerr << "loadgen: unknown cache " << name << "\n";
+                return 2;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,451 @@
+// Trace-driven hit-rate simulator: decodes a trace once and replays every request
+// against many (policy, capacity, options) configurations in parallel, writing one
+// CSV row per configuration.
+//
+//   sim --trace keys.txt --policies lru,wtinylfu,predictive --capacities 1000,10000
+//       --cms-width 1024,4096 --topk 1,2 --threads 16 > hit_rates.csv
+//   sim --zipf 1000000,0.99 --requests 50000000 --policies wtinylfu --capacities 10000
+//   sim --workload markov:n=100000,p=0.9 --requests 10000000 --policies wtinylfu,predictive
+//
+// List-valued flags are expanded as a cartesian product over the options each
+// policy actually uses. Alternatively --config FILE takes one configuration per
+// line as key=value pairs, e.g. "policy=predictive capacity=1000 topk=2 min_prob=0.1".
+//
+// Every row also carries opt_hit_rate, the offline optimum (Belady) for its capacity
+// on the same trace. This keeps the decoded trace in memory (8 bytes per request);
+// pass --no-opt to skip it for very long traces.
+//
+// Trace formats (--format): text (default) has one request per line and uses the first
+// whitespace/comma separated token as the key, hashing it if it is not an unsigned
+// integer; bin is a raw array of little-endian uint64 keys. --workload SPEC generates
+// --requests keys from the workload library instead (--zipf N,S is zipf:n=N,s=S).
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LRUCache.hpp"
+#include "LFUCache.hpp"
+#include "TinyLFUAdmittingLRU.hpp"
+#include "ShardedLRU.hpp"
+#include "ShardedWTinyLFU.hpp"
+#include "PredictiveShardedCache.hpp"
+#include "Workloads.hpp"
+#include "BeladyOracle.hpp"
+
+using Key = uint64_t;
+using Value = uint8_t; // contents are irrelevant to hit rates
+
+struct SimConfig {
+    std::string policy;
+    size_t capacity = 1000;
+    size_t shards = 8;
+    size_t cms_width = 4096;
+    size_t cms_depth = 4;
+    size_t topk = 1;
+    uint32_t min_count = 4;
+    double min_prob = 0.2;
+};
+
+static bool uses_shards(const std::string& p) { return p == "sharded-lru" || p == "wtinylfu" || p == "predictive"; }
+static bool uses_sketch(const std::string& p) { return p == "tinylfu" || p == "wtinylfu" || p == "predictive"; }
+static bool uses_predictor(const std::string& p) { return p == "predictive"; }
+
+// ---- caches behind one interface: demand fill on miss ----
+
+struct SimCache {
+    virtual ~SimCache() = default;
+    virtual bool access(Key k) = 0;
+};
+
+template <typename Cache>
+struct SimAdapter : SimCache {
+    template <typename... Args>
+    explicit SimAdapter(Args&&... args) : cache(std::forward<Args>(args)...) {}
+    bool access(Key k) override {
+        if (cache.get(k)) return true;
+        cache.put(k, Value{});
+        return false;
+    }
+    Cache cache;
+};
+
+static std::unique_ptr<SimCache> make_cache(const SimConfig& c) {
+    if (c.policy == "lru") return std::make_unique<SimAdapter<LRUCache<Key, Value>>>(c.capacity);
+    if (c.policy == "lfu") return std::make_unique<SimAdapter<LFUCache<Key, Value>>>(c.capacity);
+    if (c.policy == "tinylfu")
+        return std::make_unique<SimAdapter<TinyLFUAdmittingLRU<Key, Value>>>(c.capacity, c.cms_width, c.cms_depth);
+    if (c.policy == "sharded-lru") return std::make_unique<SimAdapter<ShardedLRU<Key, Value>>>(c.capacity, c.shards);
+    if (c.policy == "wtinylfu")
+        return std::make_unique<SimAdapter<ShardedWTinyLFU<Key, Value>>>(c.capacity, c.shards, c.cms_width, c.cms_depth);
+    if (c.policy == "predictive") {
+        PredictiveShardedCache<Key, Value>::Options o;
+        o.shards = c.shards;
+        o.prefetch_topk = c.topk;
+        o.min_trans_count = c.min_count;
+        o.min_trans_prob = c.min_prob;
+        o.cms_width = c.cms_width;
+        o.cms_depth = c.cms_depth;
+        return std::make_unique<SimAdapter<PredictiveShardedCache<Key, Value>>>(c.capacity, o);
+    }
+    throw std::invalid_argument("unknown policy: " + c.policy);
+}
+
+// ---- trace decoding ----
+
+class TraceSource {
+public:
+    virtual ~TraceSource() = default;
+    // Appends up to max keys to out (cleared first); returns false at end of trace.
+    virtual bool next_batch(std::vector<Key>& out, size_t max) = 0;
+};
+
+class TextTrace : public TraceSource {
+public:
+    explicit TextTrace(const std::string& path) : in_(path) {
+        if (!in_) throw std::runtime_error("cannot open trace: " + path);
+    }
+    bool next_batch(std::vector<Key>& out, size_t max) override {
+        out.clear();
+        std::string line;
+        while (out.size() < max && std::getline(in_, line)) {
+            const size_t b = line.find_first_not_of(" \t");
+            if (b == std::string::npos || line[b] == '#') continue;
+            const size_t e = line.find_first_of(" \t,\r", b);
+            const std::string tok = line.substr(b, e == std::string::npos ? std::string::npos : e - b);
+            char* end = nullptr;
+            const unsigned long long v = std::strtoull(tok.c_str(), &end, 10);
+            out.push_back((end && *end == '\0' && tok[0] != '-') ? Key(v) : Key(std::hash<std::string>{}(tok)));
+        }
+        return !out.empty();
+    }
+private:
+    std::ifstream in_;
+};
+
+class BinaryTrace : public TraceSource {
+public:
+    explicit BinaryTrace(const std::string& path) : in_(path, std::ios::binary) {
+        if (!in_) throw std::runtime_error("cannot open trace: " + path);
+    }
+    bool next_batch(std::vector<Key>& out, size_t max) override {
+        out.resize(max);
+        in_.read(reinterpret_cast<char*>(out.data()), std::streamsize(max * sizeof(Key)));
+        out.resize(size_t(in_.gcount()) / sizeof(Key));
+        return !out.empty();
+    }
+private:
+    std::ifstream in_;
+};
+
+// Synthetic requests from the workload library (benchmarks/Workloads.hpp).
+class WorkloadTrace : public TraceSource {
+public:
+    WorkloadTrace(const WorkloadSpec& w, uint64_t requests) : next_(make_workload(w, 123)), left_(requests) {}
+    bool next_batch(std::vector<Key>& out, size_t max) override {
+        out.clear();
+        while (out.size() < max && left_ > 0) { out.push_back(next_()); --left_; }
+        return !out.empty();
+    }
+private:
+    KeyGenerator next_;
+    uint64_t left_;
+};
+
+// ---- fixed worker pool running one parallel_for per batch ----
+
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t n) {
+        for (size_t i = 0; i < n; ++i) threads_.emplace_back([this] { loop(); });
+    }
+    ~WorkerPool() {
+        {
+            std::scoped_lock l(mu_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : threads_) t.join();
+    }
+
+    // Runs fn(i) for every i in [0, n) on the workers and waits for all of them.
+    void parallel_for(size_t n, const std::function<void(size_t)>& fn) {
+        std::unique_lock l(mu_);
+        fn_ = &fn;
+        n_ = n;
+        next_.store(0);
+        pending_ = threads_.size();
+        ++gen_;
+        cv_.notify_all();
+        done_cv_.wait(l, [&] { return pending_ == 0; });
+    }
+
+private:
+    void loop() {
+        uint64_t seen = 0;
+        std::unique_lock l(mu_);
+        for (;;) {
+            cv_.wait(l, [&] { return stop_ || gen_ != seen; });
+            if (stop_) return;
+            seen = gen_;
+            const auto* fn = fn_;
+            const size_t n = n_;
+            l.unlock();
+            for (size_t i; (i = next_.fetch_add(1)) < n;) (*fn)(i);
+            l.lock();
+            if (--pending_ == 0) done_cv_.notify_one();
+        }
+    }
+
+    std::vector<std::thread> threads_;
+    std::mutex mu_;
+    std::condition_variable cv_, done_cv_;
+    const std::function<void(size_t)>* fn_ = nullptr;
+    size_t n_ = 0, pending_ = 0;
+    std::atomic<size_t> next_{0};
+    uint64_t gen_ = 0;
+    bool stop_ = false;
+};
+
+// ---- command line ----
+
+template <typename T>
+static std::vector<T> parse_list(const std::string& s) {
+    std::vector<T> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) continue;
+        std::stringstream is(item);
+        T v;
+        if (!(is >> v)) throw std::invalid_argument("bad list item: " + item);
+        out.push_back(v);
+    }
+    return out;
+}
+
+static void set_field(SimConfig& c, const std::string& k, const std::string& v) {
+    if (k == "policy") c.policy = v;
+    else if (k == "capacity") c.capacity = std::stoull(v);
+    else if (k == "shards") c.shards = std::stoull(v);
+    else if (k == "cms_width") c.cms_width = std::stoull(v);
+    else if (k == "cms_depth") c.cms_depth = std::stoull(v);
+    else if (k == "topk") c.topk = std::stoull(v);
+    else if (k == "min_count") c.min_count = uint32_t(std::stoul(v));
+    else if (k == "min_prob") c.min_prob = std::stod(v);
+    else throw std::invalid_argument("unknown config key: " + k);
+}
+
+static std::vector<SimConfig> read_config_file(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("cannot open config: " + path);
+    std::vector<SimConfig> out;
+    std::string line;
+    while (std::getline(in, line)) {
+        const size_t hash = line.find('#');
+        if (hash != std::string::npos) line.resize(hash);
+        std::stringstream ss(line);
+        std::string kv;
+        SimConfig c;
+        bool any = false;
+        while (ss >> kv) {
+            const size_t eq = kv.find('=');
+            if (eq == std::string::npos) throw std::invalid_argument("expected key=value: " + kv);
+            set_field(c, kv.substr(0, eq), kv.substr(eq + 1));
+            any = true;
+        }
+        if (!any) continue;
+        if (c.policy.empty()) throw std::invalid_argument("config line without policy: " + line);
+        out.push_back(c);
+    }
+    return out;
+}
+
+struct Sweep {
+    std::vector<std::string> policies{"lru", "wtinylfu"};
+    std::vector<size_t> capacities{1000};
+    std::vector<size_t> shards{8};
+    std::vector<size_t> cms_widths{4096};
+    std::vector<size_t> cms_depths{4};
+    std::vector<size_t> topks{1};
+    std::vector<uint32_t> min_counts{4};
+    std::vector<double> min_probs{0.2};
+
+    std::vector<SimConfig> expand() const {
+        std::vector<SimConfig> out;
+        const std::vector<size_t> one{0};
+        for (const auto& p : policies)
+        for (size_t cap : capacities)
+        for (size_t sh : uses_shards(p) ? shards : one)
+        for (size_t w : uses_sketch(p) ? cms_widths : one)
+        for (size_t d : uses_sketch(p) ? cms_depths : one)
+        for (size_t k : uses_predictor(p) ? topks : one)
+        for (uint32_t mc : uses_predictor(p) ? min_counts : std::vector<uint32_t>{0})
+        for (double mp : uses_predictor(p) ? min_probs : std::vector<double>{0.0}) {
+            SimConfig c;
+            c.policy = p;
+            c.capacity = cap;
+            if (uses_shards(p)) c.shards = sh;
+            if (uses_sketch(p)) { c.cms_width = w; c.cms_depth = d; }
+            if (uses_predictor(p)) { c.topk = k; c.min_count = mc; c.min_prob = mp; }
+            out.push_back(c);
+        }
+        return out;
+    }
+};
+
+static void usage() {
+    std::cerr <<
+        "usage: sim (--trace FILE [--format text|bin] | (--zipf N,S | --workload SPEC) [--requests R])\n"
+        "           [--policies lru,lfu,tinylfu,sharded-lru,wtinylfu,predictive]\n"
+        "           [--capacities C,...] [--shards S,...] [--cms-width W,...] [--cms-depth D,...]\n"
+        "           [--topk K,...] [--min-count N,...] [--min-prob P,...] [--config FILE]\n"
+        "           [--threads T] [--batch B] [--out FILE] [--no-opt]\n"
+        "workloads (SPEC is name or name:param=value,...; defaults shown):\n" << workload_help();
+}
+
+struct Job {
+    SimConfig cfg;
+    std::unique_ptr<SimCache> cache;
+    uint64_t requests = 0, hits = 0;
+};
+
+// opt maps capacity -> Belady hit rate; empty when disabled.
+static void write_csv(std::ostream& os, const std::vector<Job>& jobs, const std::map<size_t, double>& opt) {
+    os << "policy,capacity,shards,cms_width,cms_depth,prefetch_topk,min_trans_count,min_trans_prob,requests,hits,hit_rate,opt_hit_rate\n";
+    for (const auto& j : jobs) {
+        const auto& c = j.cfg;
+        os << c.policy << ',' << c.capacity << ',';
+        if (uses_shards(c.policy)) os << c.shards;
+        os << ',';
+        if (uses_sketch(c.policy)) os << c.cms_width << ',' << c.cms_depth;
+        else os << ',';
+        os << ',';
+        if (uses_predictor(c.policy)) os << c.topk << ',' << c.min_count << ',' << c.min_prob;
+        else os << ",,";
+        os << ',' << j.requests << ',' << j.hits << ','
+           << (j.requests ? double(j.hits) / double(j.requests) : 0.0) << ',';
+        auto it = opt.find(c.capacity);
+        if (it != opt.end()) os << it->second;
+        os << '\n';
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        Sweep sweep;
+        std::string trace, format = "text", config, out_path, zipf, workload;
+        uint64_t requests = 10'000'000;
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        size_t batch = 1 << 16;
+        bool with_opt = true;
+
+        for (int i = 1; i < argc; ++i) {
+            const std::string a = argv[i];
+            if (a == "-h" || a == "--help") { usage(); return 0; }
+            if (a == "--no-opt") { with_opt = false; continue; }
+            if (i + 1 >= argc) { usage(); return 2; }
+            const std::string v = argv[++i];
+            if (a == "--trace") trace = v;
+            else if (a == "--format") format = v;
+            else if (a == "--zipf") zipf = v;
+            else if (a == "--workload") workload = v;
+            else if (a == "--requests") requests = std::stoull(v);
+            else if (a == "--policies") sweep.policies = parse_list<std::string>(v);
+            else if (a == "--capacities") sweep.capacities = parse_list<size_t>(v);
+            else if (a == "--shards") sweep.shards = parse_list<size_t>(v);
+            else if (a == "--cms-width") sweep.cms_widths = parse_list<size_t>(v);
+            else if (a == "--cms-depth") sweep.cms_depths = parse_list<size_t>(v);
+            else if (a == "--topk") sweep.topks = parse_list<size_t>(v);
+            else if (a == "--min-count") sweep.min_counts = parse_list<uint32_t>(v);
+            else if (a == "--min-prob") sweep.min_probs = parse_list<double>(v);
+            else if (a == "--config") config = v;
+            else if (a == "--threads") threads = std::max<size_t>(1, std::stoull(v));
+            else if (a == "--batch") batch = std::max<size_t>(1, std::stoull(v));
+            else if (a == "--out") out_path = v;
+            else { usage(); return 2; }
+        }
+
+        std::unique_ptr<TraceSource> src;
+        if (!trace.empty()) {
+            if (format == "text") src = std::make_unique<TextTrace>(trace);
+            else if (format == "bin") src = std::make_unique<BinaryTrace>(trace);
+            else throw std::invalid_argument("unknown format: " + format);
+        } else if (!zipf.empty()) {
+            const auto comma = zipf.find(',');
+            if (comma == std::string::npos) throw std::invalid_argument("--zipf expects N,S");
+            WorkloadSpec w{"zipf", {{"n", std::stod(zipf.substr(0, comma))}, {"s", std::stod(zipf.substr(comma + 1))}}};
+            src = std::make_unique<WorkloadTrace>(w, requests);
+        } else if (!workload.empty()) {
+            src = std::make_unique<WorkloadTrace>(WorkloadSpec::parse(workload), requests);
+        } else {
+            usage();
+            return 2;
+        }
+
+        std::vector<Job> jobs;
+        for (auto& c : config.empty() ? sweep.expand() : read_config_file(config)) {
+            Job j;
+            j.cfg = c;
+            j.cache = make_cache(c);
+            jobs.push_back(std::move(j));
+        }
+        std::cerr << "sim: " << jobs.size() << " configurations on " << threads << " threads\n";
+
+        // Decode batch i+1 on this thread while the pool replays batch i.
+        WorkerPool pool(std::min(threads, jobs.size()));
+        std::vector<Key> cur, next, whole; // whole: full trace, kept for OPT
+        bool more = src->next_batch(cur, batch);
+        uint64_t total = 0;
+        while (more) {
+            if (with_opt) whole.insert(whole.end(), cur.begin(), cur.end());
+            auto decoded = std::async(std::launch::async, [&] { return src->next_batch(next, batch); });
+            pool.parallel_for(jobs.size(), [&](size_t j) {
+                Job& job = jobs[j];
+                uint64_t hits = 0;
+                for (Key k : cur) hits += job.cache->access(k) ? 1 : 0;
+                job.hits += hits;
+                job.requests += cur.size();
+            });
+            total += cur.size();
+            more = decoded.get();
+            std::swap(cur, next);
+        }
+        std::cerr << "sim: replayed " << total << " requests\n";
+
+        std::map<size_t, double> opt;
+        if (with_opt) {
+            for (const auto& j : jobs) opt[j.cfg.capacity] = 0.0;
+            const BeladyOracle oracle(whole);
+            std::vector<std::pair<size_t, double>> caps(opt.begin(), opt.end());
+            pool.parallel_for(caps.size(), [&](size_t i) { caps[i].second = oracle.hit_rate(caps[i].first); });
+            for (const auto& [cap, rate] : caps) opt[cap] = rate;
+        }
+
+        if (out_path.empty()) {
+            write_csv(std::cout, jobs, opt);
+        } else {
+            std::ofstream out(out_path);
+            if (!out) throw std::runtime_error("cannot open output: " + out_path);
+            write_csv(out, jobs, opt);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "sim: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}